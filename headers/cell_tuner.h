@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "world.h"
+
+
+// Picks the solver's cell size at run time.
+//
+// The smallest legal size is the largest contact distance (2 * max radius, or the force field
+// cutoff if larger). Starting from there, a short online search tries a few multiples, runs
+// each for sample_frames frames and keeps the one with the lowest measured collision time
+// per substep. The search restarts when the radius mix changes (max or mean radius moves by
+// more than radius_tolerance), or when the ball count has moved by more than count_tolerance
+// and then held still for stable_checks checks, so a scene that keeps growing is not
+// re-measured over and over.
+class CellSizeTuner {
+public:
+    std::vector<float> multiples = {1.f, 1.25f, 1.5f, 2.f, 2.5f, 3.f};
+    uint32_t sample_frames  = 20;
+    uint32_t check_interval = 30;       // frames between radius-mix checks once settled
+    float radius_tolerance  = 0.1f;
+    float count_tolerance   = 0.25f;
+    uint32_t stable_checks  = 3;        // checks without a count change before the count counts
+
+    void update(PhysicsSolver& solver)
+    {
+        // A bigger ball can make the current cell too small, so react to it immediately
+        if (solver.getMaxRadius() > max_radius && mixChanged(solver)) {
+            startSearch(solver);
+            return;
+        }
+        if (searching) {
+            measure(solver);
+            return;
+        }
+        if (++frames_since_check >= check_interval || solver.getObjectCount() == 0) {
+            frames_since_check = 0;
+            if (mixChanged(solver))
+                startSearch(solver);
+        }
+    }
+
+    [[nodiscard]]
+    bool isSearching() const
+    {
+        return searching;
+    }
+
+    [[nodiscard]]
+    float getBestCellSize() const
+    {
+        return best_cell_size;
+    }
+
+private:
+    bool searching              = false;
+    size_t candidate            = 0;
+    uint32_t frames_sampled     = 0;
+    uint32_t frames_since_check = 0;
+    float sampled_time          = 0.f;
+    float min_cell_size         = 0.f;
+    float best_cell_size        = 0.f;
+    float best_time             = 0.f;
+    float max_radius            = 0.f;
+    float mean_radius           = 0.f;
+    size_t object_count         = 0;    // count the last search measured
+    size_t checked_count        = 0;    // count at the previous check
+    uint32_t count_stable_for   = 0;    // checks the count has not moved
+
+    bool mixChanged(const PhysicsSolver& solver)
+    {
+        if (solver.objects.empty())
+            return false;
+        float max_r = 0.f, sum_r = 0.f;
+        for (const auto& obj : solver.objects) {
+            max_r  = std::max(max_r, obj.radius);
+            sum_r += obj.radius;
+        }
+        const float mean_r = sum_r / solver.objects.size();
+        const size_t count = solver.objects.size();
+        count_stable_for = count == checked_count ? count_stable_for + 1 : 0;
+        checked_count    = count;
+
+        const bool count_changed = count_stable_for >= stable_checks
+            && std::abs(static_cast<float>(count) - object_count) > count_tolerance * object_count;
+        const bool changed = max_r > max_radius
+            || std::abs(max_r - max_radius)   > radius_tolerance * max_radius
+            || std::abs(mean_r - mean_radius) > radius_tolerance * mean_radius
+            || count_changed;
+        if (changed) {
+            max_radius   = max_r;
+            mean_radius  = mean_r;
+            object_count = count;
+        }
+        return changed;
+    }
+
+    void startSearch(PhysicsSolver& solver)
+    {
+        min_cell_size = 2.f * max_radius;
+        if (solver.force_field.short_range_strength != 0.f)
+            min_cell_size = std::max(min_cell_size, solver.force_field.short_range_cutoff);
+        solver.obstacles.setMaxBallRadius(max_radius);
+
+        searching      = true;
+        candidate      = 0;
+        best_time      = 0.f;
+        best_cell_size = min_cell_size;
+        beginCandidate(solver);
+    }
+
+    void beginCandidate(PhysicsSolver& solver)
+    {
+        frames_sampled = 0;
+        sampled_time   = 0.f;
+        solver.setCellSize(min_cell_size * multiples[candidate]);
+    }
+
+    // The first frame after a resize is skipped: it includes the reallocation
+    void measure(PhysicsSolver& solver)
+    {
+        if (frames_sampled++ > 0)
+            sampled_time += solver.getSubStepMetrics().collision_time;
+        if (frames_sampled <= sample_frames)
+            return;
+
+        const float time = sampled_time / sample_frames;
+        if (best_time == 0.f || time < best_time) {
+            best_time      = time;
+            best_cell_size = solver.getCellSize();
+        }
+        if (++candidate < multiples.size()) {
+            beginCandidate(solver);
+        } else {
+            searching = false;
+            frames_since_check = 0;
+            solver.setCellSize(best_cell_size);
+        }
+    }
+};
@@ -0,0 +1,327 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "verlet.h"
+
+
+// 16 byte ball for memory-bound scenes (VerletBall is 40). Positions are 32-bit fixed point,
+// the previous position is stored as a 16-bit fixed point delta (the per-substep move), and
+// radius and color are indices into small palettes. Once a palette is full, new values are
+// quantised to the nearest entry.
+struct CompactBall {
+    uint32_t x, y;      // position, 1 / 2^position_shift pixels
+    int16_t dx, dy;     // position - previous_position, 1 / 2^delta_shift pixels
+    uint16_t color;     // index into CompactWorld::color_palette
+    uint8_t radius;     // index into CompactWorld::radius_palette
+    uint8_t flags;      // unused, keeps the struct at 16 bytes
+};
+static_assert(sizeof(CompactBall) == 16, "CompactBall must stay 16 bytes");
+
+
+// Gauss-Seidel solver over CompactBall storage, same physics as PhysicsSolver without
+// obstacles, constraints, force fields and continuous collision. Every kernel decodes the balls it touches into
+// floats and encodes them again when done, so the arrays streamed through memory stay small.
+// The broad phase is a counting-sorted cell list (two flat arrays), not per-cell vectors.
+class CompactWorld {
+public:
+    static constexpr uint32_t position_shift = 16;      // worlds up to 65536 pixels wide
+    static constexpr uint32_t delta_shift    = 10;      // moves up to +-32 pixels per substep
+    static constexpr float position_scale    = static_cast<float>(1u << position_shift);
+    static constexpr float delta_scale       = static_cast<float>(1u << delta_shift);
+    static constexpr int32_t position_step   = 1 << (position_shift - delta_shift);   // one move unit in position units
+    static constexpr size_t max_radii        = 256;     // CompactBall::radius is 8 bits
+    static constexpr size_t max_colors       = 65536;   // CompactBall::color is 16 bits
+
+    std::vector<CompactBall> balls;
+    std::vector<float> radius_palette;      // filled by addObject, indexed by CompactBall::radius
+    std::vector<sf::Color> color_palette;   // filled by addObject, indexed by CompactBall::color
+    sf::Vector2f world_size;
+    sf::Vector2f gravity = {0.f, 150.f};
+    uint32_t sub_steps   = 1;
+
+    sf::Vector2i border_top_left;
+    sf::Vector2i border_bottom_right;
+
+    CompactWorld(sf::Vector2i size)
+        : world_size(static_cast<float>(size.x), static_cast<float>(size.y))
+        , border_top_left(50, 50)
+        , border_bottom_right(size.x - 50, size.y - 50)
+    {}
+
+    void reserve(size_t count)
+    {
+        balls.reserve(count);
+        sorted.reserve(count);
+    }
+
+    // Same arguments as PhysicsSolver::addObject; radius and color are added to the palettes
+    // if new. Past max_radii radii or max_colors colors the ball gets the nearest palette entry,
+    // see getRadius and getColor for the values actually stored.
+    void addObject(float radius, sf::Vector2f position, float speed, float angle, sf::Color color = sf::Color(0, 176, 255))
+    {
+        const sf::Vector2f move = sf::Vector2f(std::cos(angle), std::sin(angle)) * (speed * SCALE * deltaTime);
+        CompactBall ball{};
+        encodePosition(ball, position);
+        encodeDelta(ball, move);
+        ball.radius = radiusIndex(radius);
+        ball.color  = colorIndex(color);
+        balls.push_back(ball);
+        max_radius = std::max(max_radius, radius_palette[ball.radius]);
+    }
+
+    [[nodiscard]]
+    size_t getObjectCount() const
+    {
+        return balls.size();
+    }
+
+    [[nodiscard]]
+    sf::Vector2f getPosition(uint32_t idx) const
+    {
+        return decodePosition(balls[idx]);
+    }
+
+    [[nodiscard]]
+    float getRadius(uint32_t idx) const
+    {
+        return radius_palette[balls[idx].radius];
+    }
+
+    [[nodiscard]]
+    sf::Color getColor(uint32_t idx) const
+    {
+        return color_palette[balls[idx].color];
+    }
+
+    // Bytes held per ball, including the broad phase arrays
+    [[nodiscard]]
+    size_t getBytesPerBall() const
+    {
+        return sizeof(CompactBall) + sizeof(uint32_t);
+    }
+
+    void update(float dt)
+    {
+        const float sub_dt = dt / sub_steps;
+        // Cells are built after the move, so membership is exact and the cell can be as small
+        // as the contact distance
+        for (uint32_t n{0}; n < sub_steps; ++n) {
+            updateObjects(sub_dt);
+            handleBorderCollision();
+            buildCells();
+            resolveCollisions();
+        }
+    }
+
+private:
+    float max_radius = 0.f;
+    float cell_size  = 0.f;
+    uint32_t grid_width  = 0;
+    uint32_t grid_height = 0;
+    std::vector<uint32_t> cell_start;   // grid_width * grid_height + 1 offsets into sorted
+    std::vector<uint32_t> sorted;       // ball indices ordered by cell
+
+    // Palette lookups keyed by the value's bits. Values quantised to an existing entry are
+    // cached too, so only the first ball with a new value pays for the nearest-entry scan.
+    std::unordered_map<uint32_t, uint8_t> radius_lookup;
+    std::unordered_map<uint32_t, uint16_t> color_lookup;
+
+    uint8_t radiusIndex(float radius)
+    {
+        uint32_t key;
+        std::memcpy(&key, &radius, sizeof(key));
+        const auto it = radius_lookup.find(key);
+        if (it != radius_lookup.end())
+            return it->second;
+
+        size_t idx = radius_palette.size();
+        if (idx < max_radii) {
+            radius_palette.push_back(radius);
+        } else {
+            idx = 0;
+            for (size_t i{1}; i < radius_palette.size(); ++i) {
+                if (std::abs(radius_palette[i] - radius) < std::abs(radius_palette[idx] - radius))
+                    idx = i;
+            }
+        }
+        return radius_lookup[key] = static_cast<uint8_t>(idx);
+    }
+
+    uint16_t colorIndex(sf::Color color)
+    {
+        const uint32_t key = (static_cast<uint32_t>(color.r) << 24) | (static_cast<uint32_t>(color.g) << 16) |
+                             (static_cast<uint32_t>(color.b) << 8)  |  static_cast<uint32_t>(color.a);
+        const auto it = color_lookup.find(key);
+        if (it != color_lookup.end())
+            return it->second;
+
+        size_t idx = color_palette.size();
+        if (idx < max_colors) {
+            color_palette.push_back(color);
+        } else {
+            const auto distance = [&color](sf::Color other) {
+                const int dr = other.r - color.r, dg = other.g - color.g;
+                const int db = other.b - color.b, da = other.a - color.a;
+                return dr * dr + dg * dg + db * db + da * da;
+            };
+            idx = 0;
+            int best = distance(color_palette[0]);
+            for (size_t i{1}; i < color_palette.size() && best > 0; ++i) {
+                const int d = distance(color_palette[i]);
+                if (d < best) {
+                    best = d;
+                    idx  = i;
+                }
+            }
+        }
+        return color_lookup[key] = static_cast<uint16_t>(idx);
+    }
+
+    static sf::Vector2f decodePosition(const CompactBall& ball)
+    {
+        return {ball.x / position_scale, ball.y / position_scale};
+    }
+
+    static sf::Vector2f decodeDelta(const CompactBall& ball)
+    {
+        return {ball.dx / delta_scale, ball.dy / delta_scale};
+    }
+
+    static void encodePosition(CompactBall& ball, sf::Vector2f position)
+    {
+        ball.x = static_cast<uint32_t>(std::max(0.f, position.x) * position_scale + 0.5f);
+        ball.y = static_cast<uint32_t>(std::max(0.f, position.y) * position_scale + 0.5f);
+    }
+
+    // Moves beyond the delta range are clamped, which acts as a speed limit
+    static void encodeDelta(CompactBall& ball, sf::Vector2f move)
+    {
+        const float limit = 32767.f;
+        ball.dx = static_cast<int16_t>(std::clamp(std::round(move.x * delta_scale), -limit, limit));
+        ball.dy = static_cast<int16_t>(std::clamp(std::round(move.y * delta_scale), -limit, limit));
+    }
+
+    // Counting sort of the balls into cells of 2 * max radius
+    void buildCells()
+    {
+        const float wanted = std::max(2.f * max_radius, 1.f);
+        if (wanted != cell_size) {
+            cell_size   = wanted;
+            grid_width  = static_cast<uint32_t>(std::ceil(world_size.x / cell_size));
+            grid_height = static_cast<uint32_t>(std::ceil(world_size.y / cell_size));
+        }
+        cell_start.assign(grid_width * grid_height + 1, 0);
+        sorted.resize(balls.size());
+
+        // The cell is recomputed in the fill pass instead of stored, saving 4 bytes per ball
+        const float inv_cell = 1.f / (cell_size * position_scale);
+        auto cellOf = [&](const CompactBall& ball) {
+            const uint32_t cx = std::min(grid_width  - 1, static_cast<uint32_t>(ball.x * inv_cell));
+            const uint32_t cy = std::min(grid_height - 1, static_cast<uint32_t>(ball.y * inv_cell));
+            return cy * grid_width + cx;
+        };
+        for (const auto& ball : balls) {
+            ++cell_start[cellOf(ball) + 1];
+        }
+        for (size_t i{1}; i < cell_start.size(); ++i) {
+            cell_start[i] += cell_start[i - 1];
+        }
+        for (uint32_t idx{0}; idx < balls.size(); ++idx) {
+            sorted[cell_start[cellOf(balls[idx])]++] = idx;
+        }
+        // The fill pass advanced every start to the next cell's start; shift back
+        for (size_t i{cell_start.size() - 1}; i > 0; --i) {
+            cell_start[i] = cell_start[i - 1];
+        }
+        cell_start[0] = 0;
+    }
+
+    // Same integration as VerletBall::updatePosition, expressed on the stored move
+    void updateObjects(float dt)
+    {
+        for (auto& ball : balls) {
+            const sf::Vector2f move = decodeDelta(ball);
+            encodeDelta(ball, move + (gravity - move * DAMPING) * (dt * dt));
+            ball.x += static_cast<uint32_t>(ball.dx * position_step);
+            ball.y += static_cast<uint32_t>(ball.dy * position_step);
+        }
+    }
+
+    // Projects positions only, like PhysicsSolver
+    void handleBorderCollision()
+    {
+        for (auto& ball : balls) {
+            const float radius = radius_palette[ball.radius];
+            const sf::Vector2f position = decodePosition(ball);
+            const sf::Vector2f clamped(std::clamp(position.x, border_top_left.x + radius, border_bottom_right.x - radius),
+                                       std::clamp(position.y, border_top_left.y + radius, border_bottom_right.y - radius));
+            if (clamped != position)
+                moveBall(ball, clamped - position);
+        }
+    }
+
+    // Move a ball without changing its previous position. The offset is quantized once and
+    // added to both the position and the stored move in integers; rounding them separately
+    // would inject velocity noise on every contact and make piles boil.
+    static void moveBall(CompactBall& ball, sf::Vector2f offset)
+    {
+        const int32_t qx = static_cast<int32_t>(std::round(offset.x * delta_scale));
+        const int32_t qy = static_cast<int32_t>(std::round(offset.y * delta_scale));
+        ball.x += static_cast<uint32_t>(qx * position_step);
+        ball.y += static_cast<uint32_t>(qy * position_step);
+        ball.dx = static_cast<int16_t>(std::clamp(ball.dx + qx, -32767, 32767));
+        ball.dy = static_cast<int16_t>(std::clamp(ball.dy + qy, -32767, 32767));
+    }
+
+    // Cell-ordered Gauss-Seidel sweep; each ball tests the balls after it in its own cell
+    // and every ball in the four forward neighbour cells, so each pair is visited once
+    void resolveCollisions()
+    {
+        const int offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        for (uint32_t cy{0}; cy < grid_height; ++cy) {
+            for (uint32_t cx{0}; cx < grid_width; ++cx) {
+                const uint32_t cell = cy * grid_width + cx;
+                for (uint32_t i{cell_start[cell]}; i < cell_start[cell + 1]; ++i) {
+                    const uint32_t idx_a = sorted[i];
+                    for (uint32_t j{i + 1}; j < cell_start[cell + 1]; ++j) {
+                        collide(idx_a, sorted[j]);
+                    }
+                    for (const auto& offset : offsets) {
+                        const int nx = static_cast<int>(cx) + offset[0];
+                        const int ny = static_cast<int>(cy) + offset[1];
+                        if (nx < 0 || nx >= static_cast<int>(grid_width) || ny >= static_cast<int>(grid_height))
+                            continue;
+                        const uint32_t neighbour = ny * grid_width + nx;
+                        for (uint32_t j{cell_start[neighbour]}; j < cell_start[neighbour + 1]; ++j) {
+                            collide(idx_a, sorted[j]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void collide(uint32_t idx_a, uint32_t idx_b)
+    {
+        CompactBall& ballA = balls[idx_a];
+        CompactBall& ballB = balls[idx_b];
+        // Difference taken in fixed point, where it is exact
+        const sf::Vector2f delta(static_cast<int32_t>(ballB.x - ballA.x) / position_scale,
+                                 static_cast<int32_t>(ballB.y - ballA.y) / position_scale);
+        const float dist2        = delta.x * delta.x + delta.y * delta.y;
+        const float radiusA      = radius_palette[ballA.radius];
+        const float radiusB      = radius_palette[ballB.radius];
+        const float min_dist     = radiusA + radiusB;
+        if (dist2 >= min_dist * min_dist || dist2 <= EPSILON)
+            return;
+
+        const float dist              = std::sqrt(dist2);
+        const sf::Vector2f correction = delta / dist * (RESTITUTION * (min_dist - dist));
+        moveBall(ballA, -correction * (radiusB / min_dist));
+        moveBall(ballB,  correction * (radiusA / min_dist));
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#define HAVE_SFML
+#include "../utils/math.h"
+#include "../utils/thread_pool.h"
+#include "verlet.h"
+
+
+// Distance constraints (rigid links when stiffness = 1, soft springs below that) between
+// VerletBalls, stored as flat arrays. The constraint graph is greedily coloured so that no two
+// links in a batch share a ball; each batch is then solved in parallel without locks.
+class ConstraintSystem {
+public:
+    std::vector<uint32_t> ball_a;
+    std::vector<uint32_t> ball_b;
+    std::vector<float> rest_length;
+    std::vector<float> stiffness;
+
+    // Balls held at a fixed point, e.g. the top row of a cloth
+    std::vector<uint32_t> pinned_balls;
+    std::vector<sf::Vector2f> pin_positions;
+
+    void reserve(size_t count)
+    {
+        ball_a.reserve(count);
+        ball_b.reserve(count);
+        rest_length.reserve(count);
+        stiffness.reserve(count);
+    }
+
+    uint32_t addLink(uint32_t a, uint32_t b, float length, float link_stiffness = 1.f)
+    {
+        ball_a.push_back(a);
+        ball_b.push_back(b);
+        rest_length.push_back(length);
+        stiffness.push_back(link_stiffness);
+        dirty = true;
+        return static_cast<uint32_t>(ball_a.size() - 1);
+    }
+
+    // Rest length taken from the current distance between the balls
+    uint32_t addLink(const std::vector<VerletBall>& objects, uint32_t a, uint32_t b, float link_stiffness = 1.f)
+    {
+        const float length = utils::norm2f(objects[b].position - objects[a].position);
+        return addLink(a, b, length, link_stiffness);
+    }
+
+    // Link balls first .. first + count - 1 into a chain
+    void addChain(const std::vector<VerletBall>& objects, uint32_t first, uint32_t count, float link_stiffness = 1.f)
+    {
+        for (uint32_t i{1}; i < count; ++i) {
+            addLink(objects, first + i - 1, first + i, link_stiffness);
+        }
+    }
+
+    void pin(uint32_t ball_idx, sf::Vector2f position)
+    {
+        pinned_balls.push_back(ball_idx);
+        pin_positions.push_back(position);
+    }
+
+    void clear()
+    {
+        ball_a.clear();
+        ball_b.clear();
+        rest_length.clear();
+        stiffness.clear();
+        pinned_balls.clear();
+        pin_positions.clear();
+        dirty = true;
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return ball_a.empty() && pinned_balls.empty();
+    }
+
+    [[nodiscard]]
+    size_t getLinkCount() const
+    {
+        return ball_a.size();
+    }
+
+    [[nodiscard]]
+    size_t getBatchCount() const
+    {
+        return batch_offsets.empty() ? 0 : batch_offsets.size() - 1;
+    }
+
+    void solve(std::vector<VerletBall>& objects, utils::ThreadPool* pool, uint32_t iterations = 1)
+    {
+        if (dirty)
+            colour(objects.size());
+
+        for (uint32_t iteration{0}; iteration < iterations; ++iteration) {
+            for (size_t batch{0}; batch + 1 < batch_offsets.size(); ++batch) {
+                const size_t begin = batch_offsets[batch];
+                const size_t end   = batch_offsets[batch + 1];
+                // The overflow batch may share balls, so it always runs serially
+                const bool overflow = batch + 2 == batch_offsets.size() && has_overflow;
+                if (pool && !overflow && end - begin > min_parallel_batch) {
+                    pool->parallelFor(begin, end, [this, &objects](size_t start, size_t stop, size_t) {
+                        solveRange(objects, start, stop);
+                    });
+                } else {
+                    solveRange(objects, begin, end);
+                }
+            }
+        }
+
+        for (size_t i{0}; i < pinned_balls.size(); ++i) {
+            VerletBall& ball = objects[pinned_balls[i]];
+            ball.position = pin_positions[i];
+            ball.previous_position = pin_positions[i];
+        }
+    }
+
+private:
+    static constexpr uint32_t max_colours        = 64;
+    static constexpr size_t   min_parallel_batch = 2048;
+
+    // order lists link indices grouped by batch; batch k is order[batch_offsets[k] .. batch_offsets[k + 1])
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> batch_offsets;
+    bool has_overflow = false;
+    bool dirty        = true;
+
+    void solveRange(std::vector<VerletBall>& objects, size_t begin, size_t end) const
+    {
+        for (size_t i{begin}; i < end; ++i) {
+            const uint32_t link = order[i];
+            VerletBall& ballA   = objects[ball_a[link]];
+            VerletBall& ballB   = objects[ball_b[link]];
+            const sf::Vector2f delta = ballB.position - ballA.position;
+            const float dist = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+            if (dist < EPSILON)
+                continue;
+
+            // Same radius-based mass split as the collision response
+            const float total       = ballA.radius + ballB.radius;
+            const float mass_ratioA = ballA.radius / total;
+            const float mass_ratioB = ballB.radius / total;
+            const sf::Vector2f correction = delta * (stiffness[link] * (dist - rest_length[link]) / dist);
+            ballA.position += correction * mass_ratioB;
+            ballB.position -= correction * mass_ratioA;
+        }
+    }
+
+    // Greedy edge colouring with a 64-bit used-colour mask per ball. Links that find no free
+    // colour go to a final overflow batch that is solved serially.
+    void colour(size_t ball_count)
+    {
+        std::vector<uint64_t> used(ball_count, 0);
+        std::vector<uint8_t> link_colour(ball_a.size());
+        std::vector<uint32_t> batch_size(max_colours + 1, 0);
+
+        for (size_t link{0}; link < ball_a.size(); ++link) {
+            const uint64_t taken = used[ball_a[link]] | used[ball_b[link]];
+            uint32_t c = max_colours;
+            if (taken != ~uint64_t{0}) {
+                c = 0;
+                while (taken & (uint64_t{1} << c)) {
+                    ++c;
+                }
+                used[ball_a[link]] |= uint64_t{1} << c;
+                used[ball_b[link]] |= uint64_t{1} << c;
+            }
+            link_colour[link] = static_cast<uint8_t>(c);
+            ++batch_size[c];
+        }
+
+        // Counting sort of the links by colour, dropping empty colours
+        std::vector<uint32_t> cursor(max_colours + 1, 0);
+        batch_offsets.assign(1, 0);
+        uint32_t offset = 0;
+        for (uint32_t c{0}; c <= max_colours; ++c) {
+            cursor[c] = offset;
+            offset   += batch_size[c];
+            if (batch_size[c] > 0)
+                batch_offsets.push_back(offset);
+        }
+        has_overflow = batch_size[max_colours] > 0;
+
+        order.resize(ball_a.size());
+        for (uint32_t link{0}; link < ball_a.size(); ++link) {
+            order[cursor[link_colour[link]]++] = link;
+        }
+        dirty = false;
+    }
+};
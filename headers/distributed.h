@@ -0,0 +1,394 @@
+//
+// Domain decomposition across local worker processes (POSIX only).
+//
+// The world is split into vertical strips of whole grid cells. Each strip is owned by a forked
+// worker process running its own PhysicsSolver, sized to the strip plus its halo. Neighbouring
+// workers are connected by Unix domain sockets. In every substep they exchange halo balls
+// lying within halo_width of the shared edge, solve with the halo appended as ghosts, drop the
+// ghosts, and hand over balls that crossed the edge. The coordinator (the parent process) routes new balls to their tile,
+// drives the steps and gathers positions for rendering.
+//
+
+#pragma once
+#if defined(__unix__) || defined(__APPLE__)
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include "world.h"
+
+
+namespace distributed {
+
+// Wire format of one ball, in world coordinates. offset is the world position of the
+// solver's origin (a tile worker's solver starts at the left edge of its halo).
+struct BallState {
+    float x, y;
+    float previous_x, previous_y;
+    float radius;
+    uint32_t color;
+
+    static BallState fromBall(const VerletBall& ball, sf::Vector2f offset = {0.f, 0.f})
+    {
+        return {ball.position.x + offset.x, ball.position.y + offset.y,
+                ball.previous_position.x + offset.x, ball.previous_position.y + offset.y,
+                ball.radius, (uint32_t(ball.color.r) << 24) | (uint32_t(ball.color.g) << 16) | (uint32_t(ball.color.b) << 8) | ball.color.a};
+    }
+
+    VerletBall& addTo(PhysicsSolver& solver, sf::Vector2f offset = {0.f, 0.f}) const
+    {
+        VerletBall& ball = solver.addObject(radius, {x - offset.x, y - offset.y}, 0.f, 0.f);
+        ball.previous_position = {previous_x - offset.x, previous_y - offset.y};
+        ball.color = sf::Color(color >> 24, (color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff);
+        return ball;
+    }
+};
+
+enum class Command : uint32_t {
+    Add,
+    Step,
+    Gather,
+    Quit
+};
+
+struct Header {
+    Command command;
+    uint32_t count;     // BallStates following the header
+    float dt;
+    uint32_t sub_steps;
+};
+
+
+inline void writeAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw std::runtime_error("distributed: socket write failed");
+        bytes += written;
+        size  -= static_cast<size_t>(written);
+    }
+}
+
+inline void readAll(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t received = ::read(fd, bytes, size);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            throw std::runtime_error("distributed: socket read failed");
+        bytes += received;
+        size  -= static_cast<size_t>(received);
+    }
+}
+
+inline void sendBalls(int fd, Header header, const std::vector<BallState>& balls)
+{
+    header.count = static_cast<uint32_t>(balls.size());
+    writeAll(fd, &header, sizeof(header));
+    if (!balls.empty())
+        writeAll(fd, balls.data(), balls.size() * sizeof(BallState));
+}
+
+inline Header receiveBalls(int fd, std::vector<BallState>& balls)
+{
+    Header header;
+    readAll(fd, &header, sizeof(header));
+    balls.resize(header.count);
+    if (header.count > 0)
+        readAll(fd, balls.data(), balls.size() * sizeof(BallState));
+    return header;
+}
+
+
+// Runs inside a forked process and owns the balls of one strip. Its solver only covers the
+// strip plus halo_width on each side, with the origin at the left edge of the halo; balls
+// are moved into and out of those coordinates at the sockets. The world's side walls are kept
+// where the strip meets them and moved out of reach at edges shared with a neighbour.
+class TileWorker {
+public:
+    TileWorker(sf::Vector2i world_size, float x_begin, float x_end, float halo_width,
+               int coordinator_fd, int left_fd, int right_fd, uint32_t tile_index)
+        : solver(sf::Vector2i(static_cast<int>(std::ceil(x_end - x_begin + 2.f * halo_width)), world_size.y))
+        , offset(x_begin - halo_width, 0.f)
+        , x_begin(halo_width), x_end(x_end - x_begin + halo_width), halo_width(halo_width)
+        , coordinator_fd(coordinator_fd), left_fd(left_fd), right_fd(right_fd)
+        , tile_index(tile_index)
+    {
+        solver.setSubsSteps(1);
+        const sf::Vector2i inset = solver.border_top_left;     // the default walls' distance from the edges
+        const int width = static_cast<int>(solver.world_size.x);
+        const int shift = static_cast<int>(offset.x);
+        const int left  = left_fd  < 0 ? inset.x - shift : -width;
+        const int right = right_fd < 0 ? world_size.x - inset.x - shift : 2 * width;
+        solver.setBorder({left, inset.y}, {right, world_size.y - inset.y});
+    }
+
+    void run()
+    {
+        std::vector<BallState> incoming;
+        while (true) {
+            const Header header = receiveBalls(coordinator_fd, incoming);
+            switch (header.command) {
+                case Command::Add:
+                    for (const BallState& state : incoming) {
+                        state.addTo(solver, offset);
+                    }
+                    break;
+                case Command::Step:
+                    for (uint32_t n{0}; n < header.sub_steps; ++n) {
+                        subStep(header.dt / header.sub_steps);
+                    }
+                    sendBalls(coordinator_fd, {Command::Step, 0, 0.f, 0}, {});
+                    break;
+                case Command::Gather:
+                    outgoing.clear();
+                    for (const VerletBall& ball : solver.objects) {
+                        outgoing.push_back(BallState::fromBall(ball, offset));
+                    }
+                    sendBalls(coordinator_fd, {Command::Gather, 0, 0.f, 0}, outgoing);
+                    break;
+                case Command::Quit:
+                    return;
+            }
+        }
+    }
+
+private:
+    PhysicsSolver solver;
+    sf::Vector2f offset;                // world position of the solver's origin
+    float x_begin, x_end, halo_width;   // strip edges in solver coordinates
+    int coordinator_fd, left_fd, right_fd;
+    uint32_t tile_index;
+    std::vector<BallState> outgoing, to_left, to_right, from_left, from_right;
+
+    // Pairs (0,1), (2,3), ... exchange first, then (1,2), (3,4), ...; the left tile of a pair
+    // sends first, so no two workers ever wait on each other
+    template <typename Collect, typename Accept>
+    void exchangeWithNeighbours(Collect&& collect, Accept&& accept)
+    {
+        collect(to_left, to_right);
+        const bool even = tile_index % 2 == 0;
+        for (int phase = 0; phase < 2; ++phase) {
+            const bool with_right = (phase == 0) == even;
+            if (with_right && right_fd >= 0) {
+                sendBalls(right_fd, {Command::Step, 0, 0.f, 0}, to_right);
+                receiveBalls(right_fd, from_right);
+                accept(from_right);
+            } else if (!with_right && left_fd >= 0) {
+                receiveBalls(left_fd, from_left);
+                sendBalls(left_fd, {Command::Step, 0, 0.f, 0}, to_left);
+                accept(from_left);
+            }
+        }
+    }
+
+    void subStep(float sub_dt)
+    {
+        // Halo: owned balls near an edge travel to the neighbour as ghosts
+        const size_t owned = solver.objects.size();
+        exchangeWithNeighbours(
+            [this](std::vector<BallState>& left, std::vector<BallState>& right) {
+                left.clear();
+                right.clear();
+                for (const VerletBall& ball : solver.objects) {
+                    if (ball.position.x < x_begin + halo_width) left.push_back(BallState::fromBall(ball, offset));
+                    if (ball.position.x >= x_end - halo_width)  right.push_back(BallState::fromBall(ball, offset));
+                }
+            },
+            [this](const std::vector<BallState>& ghosts) {
+                for (const BallState& state : ghosts) {
+                    state.addTo(solver, offset);
+                }
+            });
+
+        solver.update(sub_dt);
+        solver.objects.erase(solver.objects.begin() + owned, solver.objects.end());
+
+        // Migration: balls that left the strip change owner
+        exchangeWithNeighbours(
+            [this](std::vector<BallState>& left, std::vector<BallState>& right) {
+                left.clear();
+                right.clear();
+                auto& objects = solver.objects;
+                size_t kept = 0;
+                for (size_t i{0}; i < objects.size(); ++i) {
+                    const VerletBall& ball = objects[i];
+                    if (ball.position.x < x_begin && left_fd >= 0)
+                        left.push_back(BallState::fromBall(ball, offset));
+                    else if (ball.position.x >= x_end && right_fd >= 0)
+                        right.push_back(BallState::fromBall(ball, offset));
+                    else
+                        objects[kept++] = ball;
+                }
+                objects.erase(objects.begin() + kept, objects.end());
+            },
+            [this](const std::vector<BallState>& migrants) {
+                for (const BallState& state : migrants) {
+                    state.addTo(solver, offset);
+                }
+            });
+    }
+};
+
+
+// Lives in the parent process. Forks one TileWorker per strip on construction and shuts
+// them down on destruction.
+class DistributedWorld {
+public:
+    DistributedWorld(sf::Vector2i world_size, uint32_t tile_count, float cell_size = 8.f)
+        : world_size(world_size)
+    {
+        tile_count = std::max(1u, tile_count);
+        const uint32_t columns = static_cast<uint32_t>(std::ceil(world_size.x / cell_size));
+        for (uint32_t k{0}; k <= tile_count; ++k) {
+            tile_edges.push_back(k == tile_count ? static_cast<float>(world_size.x)
+                                                 : (columns * k / tile_count) * cell_size);
+        }
+
+        std::vector<int> coordinator_fds(tile_count * 2), neighbour_fds((tile_count - 1) * 2);
+        for (uint32_t k{0}; k < tile_count; ++k) {
+            makeSocketPair(&coordinator_fds[2 * k]);
+        }
+        for (uint32_t k{0}; k + 1 < tile_count; ++k) {
+            makeSocketPair(&neighbour_fds[2 * k]);
+        }
+
+        for (uint32_t k{0}; k < tile_count; ++k) {
+            const pid_t pid = fork();
+            if (pid < 0)
+                throw std::runtime_error("distributed: fork failed");
+            if (pid == 0) {
+                // Worker k keeps its coordinator end, the right end of pair k - 1 and the left end of pair k
+                const int coordinator_fd = coordinator_fds[2 * k + 1];
+                const int left_fd  = k > 0 ? neighbour_fds[2 * (k - 1) + 1] : -1;
+                const int right_fd = k + 1 < tile_count ? neighbour_fds[2 * k] : -1;
+                for (const int fd : coordinator_fds) if (fd != coordinator_fd) ::close(fd);
+                for (const int fd : neighbour_fds)   if (fd != left_fd && fd != right_fd) ::close(fd);
+                for (const int fd : worker_fds)      ::close(fd);
+
+                int status = 0;
+                try {
+                    TileWorker worker(world_size, tile_edges[k], tile_edges[k + 1], 2.f * cell_size,
+                                      coordinator_fd, left_fd, right_fd, k);
+                    worker.run();
+                } catch (const std::exception&) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            workers.push_back(pid);
+            worker_fds.push_back(coordinator_fds[2 * k]);
+            ::close(coordinator_fds[2 * k + 1]);
+        }
+        for (const int fd : neighbour_fds) ::close(fd);
+        pending_adds.resize(tile_count);
+    }
+
+    ~DistributedWorld()
+    {
+        for (const int fd : worker_fds) {
+            try {
+                sendBalls(fd, {Command::Quit, 0, 0.f, 0}, {});
+            } catch (const std::exception&) {}
+            ::close(fd);
+        }
+        for (const pid_t pid : workers) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    DistributedWorld(const DistributedWorld&) = delete;
+    DistributedWorld& operator=(const DistributedWorld&) = delete;
+
+    [[nodiscard]]
+    uint32_t getTileCount() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+    // Buffered until the next step
+    void addObject(float radius, sf::Vector2f position, float speed, float angle, sf::Color color = sf::Color(0, 176, 255))
+    {
+        VerletBall ball(radius, position, speed, angle);
+        ball.color = color;
+        pending_adds[tileOf(position.x)].push_back(BallState::fromBall(ball));
+    }
+
+    void update(float dt, uint32_t sub_steps = 1)
+    {
+        flushAdds();
+        for (const int fd : worker_fds) {
+            sendBalls(fd, {Command::Step, 0, dt, sub_steps}, {});
+        }
+        std::vector<BallState> ack;
+        for (const int fd : worker_fds) {
+            receiveBalls(fd, ack);
+        }
+    }
+
+    // Replace target.objects with the balls of every tile, e.g. to feed the Renderer.
+    // tile_counts (optional) receives the number of balls owned by each tile.
+    void gather(PhysicsSolver& target, std::vector<uint32_t>* tile_counts = nullptr)
+    {
+        flushAdds();
+        for (const int fd : worker_fds) {
+            sendBalls(fd, {Command::Gather, 0, 0.f, 0}, {});
+        }
+        target.objects.clear();
+        if (tile_counts)
+            tile_counts->clear();
+        for (const int fd : worker_fds) {
+            receiveBalls(fd, gathered);
+            for (const BallState& state : gathered) {
+                state.addTo(target);
+            }
+            if (tile_counts)
+                tile_counts->push_back(static_cast<uint32_t>(gathered.size()));
+        }
+    }
+
+private:
+    sf::Vector2i world_size;
+    std::vector<float> tile_edges;
+    std::vector<pid_t> workers;
+    std::vector<int> worker_fds;
+    std::vector<std::vector<BallState>> pending_adds;
+    std::vector<BallState> gathered;
+
+    static void makeSocketPair(int* fds)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            throw std::runtime_error("distributed: socketpair failed");
+    }
+
+    uint32_t tileOf(float x) const
+    {
+        const auto it = std::upper_bound(tile_edges.begin() + 1, tile_edges.end() - 1, x);
+        return static_cast<uint32_t>(it - (tile_edges.begin() + 1));
+    }
+
+    void flushAdds()
+    {
+        for (size_t k{0}; k < worker_fds.size(); ++k) {
+            if (pending_adds[k].empty())
+                continue;
+            sendBalls(worker_fds[k], {Command::Add, 0, 0.f, 0}, pending_adds[k]);
+            pending_adds[k].clear();
+        }
+    }
+};
+
+}
+#endif
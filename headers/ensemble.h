@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include "world.h"
+#include "../utils/thread_pool.h"
+
+
+// Result of one ensemble member after a run
+struct MemberResult {
+    SolverConfig config;
+    uint32_t frames        = 0;
+    double seconds         = 0.0;    // wall time spent stepping this member
+    float max_penetration  = 0.f;    // deepest overlap of the last frame, in contact distances
+    float mean_height      = 0.f;    // mean ball y
+    float kinetic_energy   = 0.f;    // mean squared per-frame move, pixels^2
+};
+
+// Aggregate over every member of a run
+struct EnsembleSummary {
+    uint32_t members           = 0;
+    uint64_t ball_frames       = 0;  // sum of balls * frames
+    double wall_seconds        = 0.0;
+    double member_seconds      = 0.0;  // sum of per-member times, including time spent preempted
+    float worst_penetration    = 0.f;
+    float mean_kinetic_energy  = 0.f;
+};
+
+
+// Many small independent solvers, each with its own SolverConfig. run() hands one member to
+// each pool task; a member is only touched by the task stepping it, so nothing is shared but
+// the metrics registry (per-thread slots). Members never get the pool themselves: nested
+// parallelFor on a pool that is already busy with ensemble tasks would deadlock.
+class Ensemble {
+public:
+    Ensemble(sf::Vector2i size) : world_size(size) {}
+
+    // Adds a member and returns it for filling; the reference stays valid (members are heap allocated)
+    PhysicsSolver& add(const SolverConfig& config)
+    {
+        members.push_back(std::make_unique<PhysicsSolver>(world_size));
+        members.back()->setConfig(config);
+        results.emplace_back();
+        return *members.back();
+    }
+
+    [[nodiscard]]
+    size_t size() const
+    {
+        return members.size();
+    }
+
+    [[nodiscard]]
+    PhysicsSolver& member(size_t idx)
+    {
+        return *members[idx];
+    }
+
+    // Step every member frames times; blocks until all are done
+    EnsembleSummary run(uint32_t frames, float dt, utils::ThreadPool& pool)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t idx{0}; idx < members.size(); ++idx) {
+            pool.enqueue([this, idx, frames, dt] { runMember(idx, frames, dt); });
+        }
+        pool.wait();
+        const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summarize(wall);
+    }
+
+    [[nodiscard]]
+    const std::vector<MemberResult>& getResults() const
+    {
+        return results;
+    }
+
+private:
+    sf::Vector2i world_size;
+    std::vector<std::unique_ptr<PhysicsSolver>> members;
+    std::vector<MemberResult> results;
+
+    void runMember(size_t idx, uint32_t frames, float dt)
+    {
+        PhysicsSolver& solver = *members[idx];
+        solver.setThreadPool(nullptr);
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t done = solver.advance(frames, dt);
+
+        MemberResult& result   = results[idx];
+        result.config          = solver.getConfig();
+        result.frames          = done;
+        result.seconds         = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.max_penetration = solver.getSubStepMetrics().max_penetration;
+        double height = 0.0, energy = 0.0;
+        for (const auto& obj : solver.objects) {
+            const sf::Vector2f move = obj.position - obj.previous_position;
+            height += obj.position.y;
+            energy += move.x * move.x + move.y * move.y;
+        }
+        const double count    = static_cast<double>(std::max<size_t>(1, solver.objects.size()));
+        const double per_step = static_cast<double>(solver.getSubSteps());
+        result.mean_height    = static_cast<float>(height / count);
+        // previous_position is one substep back; scale the move to a whole frame
+        result.kinetic_energy = static_cast<float>(energy / count * per_step * per_step);
+    }
+
+    EnsembleSummary summarize(double wall_seconds) const
+    {
+        EnsembleSummary summary;
+        summary.members      = static_cast<uint32_t>(members.size());
+        summary.wall_seconds = wall_seconds;
+        for (size_t idx{0}; idx < members.size(); ++idx) {
+            const MemberResult& result = results[idx];
+            summary.ball_frames         += static_cast<uint64_t>(members[idx]->getObjectCount()) * result.frames;
+            summary.member_seconds      += result.seconds;
+            summary.worst_penetration    = std::max(summary.worst_penetration, result.max_penetration);
+            summary.mean_kinetic_energy += result.kinetic_energy;
+        }
+        if (!members.empty())
+            summary.mean_kinetic_energy /= static_cast<float>(members.size());
+        return summary;
+    }
+};
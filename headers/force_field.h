@@ -0,0 +1,230 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#define HAVE_SFML
+#include "../utils/math.h"
+#include "../utils/thread_pool.h"
+#include "verlet_grid.h"
+
+
+// Particle-to-particle forces, computed once per substep into per-ball accelerations.
+//
+// Short range: a pairwise kernel over the 3x3 cell neighbourhood of the collision grid, so
+// short_range_cutoff must not exceed the grid's cell size. Positive strength repels,
+// negative strength gives cohesion.
+//
+// Long range: Barnes-Hut style gravity on a pyramid built over the grid. Level 0 holds the
+// mass and centroid of every grid cell, and each coarser level merges 2x2 nodes. The field is
+// evaluated at the nodes of field_level by descending the pyramid until a node is small
+// compared to its distance (size / distance < opening_angle). It is then interpolated
+// bilinearly to the balls, so the cost depends on the grid resolution and not on the ball count.
+class ForceField {
+public:
+    float short_range_strength = 0.f;    // acceleration at zero distance
+    float short_range_cutoff   = 8.f;
+    float gravity_constant     = 0.f;    // 0 disables the far field
+    float softening            = 16.f;   // avoids the singularity inside a node
+    float opening_angle        = 0.5f;
+    uint32_t field_level       = 2;      // pyramid level the far field is sampled on
+
+    std::vector<sf::Vector2f> accelerations;
+
+    [[nodiscard]]
+    bool isEnabled() const
+    {
+        return short_range_strength != 0.f || gravity_constant != 0.f;
+    }
+
+    void compute(const std::vector<VerletBall>& objects, const Grid& grid, utils::ThreadPool* pool)
+    {
+        accelerations.assign(objects.size(), {0.f, 0.f});
+
+        if (gravity_constant != 0.f) {
+            buildPyramid(objects, grid);
+            computeFarField(pool);
+            run(pool, objects.size(), [&](size_t begin, size_t end) {
+                for (size_t i{begin}; i < end; ++i) {
+                    accelerations[i] += sampleFarField(objects[i].position);
+                }
+            });
+        }
+
+        if (short_range_strength != 0.f) {
+            run(pool, grid.grid_height, [&](size_t begin, size_t end) {
+                applyShortRange(objects, grid, begin, end);
+            });
+        }
+    }
+
+private:
+    struct Node {
+        float mass = 0.f;
+        sf::Vector2f weighted_position = {0.f, 0.f}; // sum of mass * position
+    };
+
+    struct Level {
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        float node_size = 0.f;
+        std::vector<Node> nodes;
+    };
+
+    std::vector<Level> levels;
+    std::vector<sf::Vector2f> far_field;   // one sample per node of field_level
+
+    template <typename F>
+    static void run(utils::ThreadPool* pool, size_t count, F&& fn)
+    {
+        if (pool)
+            pool->parallelFor(0, count, [&fn](size_t begin, size_t end, size_t) { fn(begin, end); });
+        else
+            fn(size_t{0}, count);
+    }
+
+    // Ball mass follows the radius-based mass ratio used by the collision response
+    void buildPyramid(const std::vector<VerletBall>& objects, const Grid& grid)
+    {
+        uint32_t width  = grid.grid_width;
+        uint32_t height = grid.grid_height;
+        float size      = grid.cell_size;
+        size_t level_count = 0;
+        while (true) {
+            if (levels.size() <= level_count)
+                levels.emplace_back();
+            Level& level = levels[level_count++];
+            level.width = width;
+            level.height = height;
+            level.node_size = size;
+            level.nodes.assign(width * height, Node{});
+            if (width == 1 && height == 1)
+                break;
+            width  = (width  + 1) / 2;
+            height = (height + 1) / 2;
+            size  *= 2.f;
+        }
+        levels.resize(level_count);
+
+        Level& base = levels[0];
+        for (size_t cell{0}; cell < grid.cells.size(); ++cell) {
+            Node& node = base.nodes[cell];
+            for (const uint32_t idx : grid.cells[cell].ball_indices) {
+                const VerletBall& ball = objects[idx];
+                const float mass = ball.radius;
+                node.mass += mass;
+                node.weighted_position += ball.position * mass;
+            }
+        }
+
+        for (size_t l{1}; l < levels.size(); ++l) {
+            const Level& fine = levels[l - 1];
+            Level& coarse = levels[l];
+            for (uint32_t y{0}; y < fine.height; ++y) {
+                for (uint32_t x{0}; x < fine.width; ++x) {
+                    const Node& child = fine.nodes[y * fine.width + x];
+                    Node& parent = coarse.nodes[(y / 2) * coarse.width + x / 2];
+                    parent.mass += child.mass;
+                    parent.weighted_position += child.weighted_position;
+                }
+            }
+        }
+    }
+
+    sf::Vector2f evaluate(const sf::Vector2f& point) const
+    {
+        struct Entry { uint32_t level, x, y; };
+        Entry stack[64];
+        size_t top = 0;
+        stack[top++] = {static_cast<uint32_t>(levels.size() - 1), 0, 0};
+
+        const float softening2 = softening * softening;
+        const float theta2     = opening_angle * opening_angle;
+        sf::Vector2f acceleration = {0.f, 0.f};
+        while (top > 0) {
+            const Entry entry  = stack[--top];
+            const Level& level = levels[entry.level];
+            const Node& node   = level.nodes[entry.y * level.width + entry.x];
+            if (node.mass <= 0.f)
+                continue;
+
+            const sf::Vector2f centroid = node.weighted_position / node.mass;
+            const sf::Vector2f delta    = centroid - point;
+            const float dist2           = delta.x * delta.x + delta.y * delta.y;
+            const float size2           = level.node_size * level.node_size;
+
+            if (entry.level == 0 || size2 < theta2 * dist2) {
+                const float soft = dist2 + softening2;
+                acceleration += delta * (gravity_constant * node.mass / (soft * std::sqrt(soft)));
+                continue;
+            }
+
+            const Level& child = levels[entry.level - 1];
+            for (uint32_t cy = entry.y * 2; cy < std::min(child.height, entry.y * 2 + 2); ++cy) {
+                for (uint32_t cx = entry.x * 2; cx < std::min(child.width, entry.x * 2 + 2); ++cx) {
+                    stack[top++] = {entry.level - 1, cx, cy};
+                }
+            }
+        }
+        return acceleration;
+    }
+
+    void computeFarField(utils::ThreadPool* pool)
+    {
+        const Level& level = levels[std::min<size_t>(field_level, levels.size() - 1)];
+        far_field.assign(level.width * level.height, {0.f, 0.f});
+        run(pool, level.height, [&](size_t begin, size_t end) {
+            for (size_t y{begin}; y < end; ++y) {
+                for (uint32_t x{0}; x < level.width; ++x) {
+                    const sf::Vector2f center((x + 0.5f) * level.node_size, (y + 0.5f) * level.node_size);
+                    far_field[y * level.width + x] = evaluate(center);
+                }
+            }
+        });
+    }
+
+    sf::Vector2f sampleFarField(const sf::Vector2f& position) const
+    {
+        const Level& level = levels[std::min<size_t>(field_level, levels.size() - 1)];
+        const float fx = std::clamp(position.x / level.node_size - 0.5f, 0.f, static_cast<float>(level.width  - 1));
+        const float fy = std::clamp(position.y / level.node_size - 0.5f, 0.f, static_cast<float>(level.height - 1));
+        const uint32_t x0 = static_cast<uint32_t>(fx);
+        const uint32_t y0 = static_cast<uint32_t>(fy);
+        const uint32_t x1 = std::min(x0 + 1, level.width  - 1);
+        const uint32_t y1 = std::min(y0 + 1, level.height - 1);
+        const float tx = fx - x0;
+        const float ty = fy - y0;
+        const sf::Vector2f top    = far_field[y0 * level.width + x0] * (1.f - tx) + far_field[y0 * level.width + x1] * tx;
+        const sf::Vector2f bottom = far_field[y1 * level.width + x0] * (1.f - tx) + far_field[y1 * level.width + x1] * tx;
+        return top * (1.f - ty) + bottom * ty;
+    }
+
+    // Linear falloff kernel, gathered per ball so each row range only writes its own balls
+    void applyShortRange(const std::vector<VerletBall>& objects, const Grid& grid, size_t row_begin, size_t row_end)
+    {
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        const float cutoff2 = short_range_cutoff * short_range_cutoff;
+        for (int y = static_cast<int>(row_begin); y < static_cast<int>(row_end); ++y) {
+            for (int x{0}; x < width; ++x) {
+                for (const uint32_t idx_a : grid.getCell(x, y).ball_indices) {
+                    const sf::Vector2f position = objects[idx_a].position;
+                    sf::Vector2f acceleration = {0.f, 0.f};
+                    for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny) {
+                        for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx) {
+                            for (const uint32_t idx_b : grid.getCell(nx, ny).ball_indices) {
+                                const sf::Vector2f delta = position - objects[idx_b].position;
+                                const float dist2 = delta.x * delta.x + delta.y * delta.y;
+                                if (dist2 < cutoff2 && dist2 > EPSILON) {
+                                    const float dist = std::sqrt(dist2);
+                                    acceleration += delta * (short_range_strength * (1.f - dist / short_range_cutoff) / dist);
+                                }
+                            }
+                        }
+                    }
+                    accelerations[idx_a] += acceleration;
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#define HAVE_SFML
+#include "../utils/math.h"
+#include "../utils/thread_pool.h"
+#include "verlet_grid.h"
+
+
+struct RaycastHit {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    float distance = std::numeric_limits<float>::infinity();
+
+    [[nodiscard]]
+    bool hit() const
+    {
+        return index != std::numeric_limits<uint32_t>::max();
+    }
+};
+
+
+// Read-only spatial queries over a built Grid. Nothing is mutated, so any number of threads
+// may query the same grid at once (but not while the solver is updating it).
+// Ball positions are tested exactly. Cell ranges are padded by one cell because grid
+// membership is recorded at the start of the last substep.
+class GridQuery {
+private:
+    const Grid& grid;
+    const std::vector<VerletBall>& objects;
+
+    // Clamped cell range covering [min, max] plus the one cell of slack
+    void cellRange(sf::Vector2f min, sf::Vector2f max, int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = std::max(0, static_cast<int>(std::floor(min.x / grid.cell_size)) - 1);
+        y0 = std::max(0, static_cast<int>(std::floor(min.y / grid.cell_size)) - 1);
+        x1 = std::min(static_cast<int>(grid.grid_width)  - 1, static_cast<int>(std::floor(max.x / grid.cell_size)) + 1);
+        y1 = std::min(static_cast<int>(grid.grid_height) - 1, static_cast<int>(std::floor(max.y / grid.cell_size)) + 1);
+    }
+
+public:
+    GridQuery(const Grid& grid, const std::vector<VerletBall>& objects)
+        : grid(grid)
+        , objects(objects)
+    {}
+
+    // fn(index) for every ball whose centre lies within radius of center
+    template <typename F>
+    void forEachInRadius(const sf::Vector2f& center, float radius, F&& fn) const
+    {
+        int x0, y0, x1, y1;
+        cellRange(center - sf::Vector2f(radius, radius), center + sf::Vector2f(radius, radius), x0, y0, x1, y1);
+        const float radius2 = radius * radius;
+        for (int y{y0}; y <= y1; ++y) {
+            for (int x{x0}; x <= x1; ++x) {
+                for (const uint32_t idx : grid.getCell(x, y).ball_indices) {
+                    const sf::Vector2f delta = objects[idx].position - center;
+                    if (delta.x * delta.x + delta.y * delta.y <= radius2)
+                        fn(idx);
+                }
+            }
+        }
+    }
+
+    // fn(index) for every ball whose centre lies inside [min, max]
+    template <typename F>
+    void forEachInAABB(const sf::Vector2f& min, const sf::Vector2f& max, F&& fn) const
+    {
+        int x0, y0, x1, y1;
+        cellRange(min, max, x0, y0, x1, y1);
+        for (int y{y0}; y <= y1; ++y) {
+            for (int x{x0}; x <= x1; ++x) {
+                for (const uint32_t idx : grid.getCell(x, y).ball_indices) {
+                    const sf::Vector2f& p = objects[idx].position;
+                    if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y)
+                        fn(idx);
+                }
+            }
+        }
+    }
+
+    // Indices of the k balls closest to point, nearest first. Rings of cells are searched
+    // outwards until the ring is further away than the current k-th candidate.
+    void kNearest(const sf::Vector2f& point, uint32_t k, std::vector<uint32_t>& result) const
+    {
+        result.clear();
+        if (k == 0)
+            return;
+
+        // Max-heap on distance holding the best k so far
+        std::vector<std::pair<float, uint32_t>> heap;
+        heap.reserve(k + 1);
+        auto consider = [&](uint32_t idx) {
+            const sf::Vector2f delta = objects[idx].position - point;
+            const float dist2 = delta.x * delta.x + delta.y * delta.y;
+            if (heap.size() < k) {
+                heap.emplace_back(dist2, idx);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (dist2 < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = {dist2, idx};
+                std::push_heap(heap.begin(), heap.end());
+            }
+        };
+
+        const int cx = static_cast<int>(std::floor(point.x / grid.cell_size));
+        const int cy = static_cast<int>(std::floor(point.y / grid.cell_size));
+        const int max_ring = static_cast<int>(std::max(grid.grid_width, grid.grid_height));
+        for (int ring{0}; ring <= max_ring; ++ring) {
+            // Balls in ring r are at least (r - 2) cells away: one for the ring geometry and one of slack
+            if (heap.size() == k) {
+                const float reach = std::max(0, ring - 2) * grid.cell_size;
+                if (reach * reach > heap.front().first)
+                    break;
+            }
+            for (int y{cy - ring}; y <= cy + ring; ++y) {
+                if (y < 0 || y >= static_cast<int>(grid.grid_height))
+                    continue;
+                const bool edge_row = y == cy - ring || y == cy + ring;
+                for (int x{cx - ring}; x <= cx + ring; x += (edge_row ? 1 : 2 * std::max(ring, 1))) {
+                    if (x >= 0 && x < static_cast<int>(grid.grid_width)) {
+                        for (const uint32_t idx : grid.getCell(x, y).ball_indices) {
+                            consider(idx);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::sort_heap(heap.begin(), heap.end());
+        for (const auto& entry : heap) {
+            result.push_back(entry.second);
+        }
+    }
+
+    // First ball hit by the ray origin + t * direction, t in [0, max_distance].
+    // direction does not need to be normalised; the distance is along the normalised ray.
+    [[nodiscard]]
+    RaycastHit raycast(const sf::Vector2f& origin, const sf::Vector2f& direction, float max_distance) const
+    {
+        RaycastHit best;
+        const sf::Vector2f dir = utils::normalize(direction);
+        if (dir.x == 0.f && dir.y == 0.f)
+            return best;
+
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        grid.forEachCellOnSegment(origin, origin + dir * max_distance, [&](int cell_x, int cell_y) {
+            // Cells whose centre is two cells past the best hit cannot improve it
+            const sf::Vector2f center((cell_x + 0.5f) * grid.cell_size, (cell_y + 0.5f) * grid.cell_size);
+            if (utils::dot(center - origin, dir) - 2.f * grid.cell_size > best.distance)
+                return false;
+
+            for (int ny = std::max(0, cell_y - 1); ny <= std::min(height - 1, cell_y + 1); ++ny) {
+                for (int nx = std::max(0, cell_x - 1); nx <= std::min(width - 1, cell_x + 1); ++nx) {
+                    for (const uint32_t idx : grid.getCell(nx, ny).ball_indices) {
+                        const VerletBall& ball   = objects[idx];
+                        const sf::Vector2f offset = origin - ball.position;
+                        const float b = utils::dot(offset, dir);
+                        const float c = utils::dot(offset, offset) - ball.radius * ball.radius;
+                        const float discriminant = b * b - c;
+                        if (discriminant < 0.f)
+                            continue;
+                        const float t = c <= 0.f ? 0.f : -b - std::sqrt(discriminant);
+                        // Ties (e.g. an origin inside several balls) go to the lowest index
+                        if (t >= 0.f && t <= max_distance && (t < best.distance || (t == best.distance && idx < best.index)))
+                            best = {idx, t};
+                    }
+                }
+            }
+            return true;
+        });
+        return best;
+    }
+
+    // Run one query per element of queries on the pool; fn(query, query_index) must only
+    // write to per-query output
+    template <typename Query, typename F>
+    void batch(const std::vector<Query>& queries, utils::ThreadPool* pool, F&& fn) const
+    {
+        auto run = [&](size_t begin, size_t end, size_t) {
+            for (size_t i{begin}; i < end; ++i) {
+                fn(queries[i], i);
+            }
+        };
+        if (pool)
+            pool->parallelFor(0, queries.size(), run);
+        else
+            run(0, queries.size(), 0);
+    }
+};
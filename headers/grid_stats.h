@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "verlet_grid.h"
+
+
+// Occupancy statistics of a Grid plus the time the collision sweep spends per stripe of rows.
+// Per-cell occupancy and stripe times are exponential moving averages, so one slow frame does
+// not dominate the picture. update() is O(cells) and meant to run once per displayed frame.
+class GridStatistics {
+public:
+    static constexpr uint32_t histogram_bins = 16;   // the last bin counts everything above
+
+    uint32_t stripe_rows = 8;                        // grid rows per timed stripe
+    float smoothing      = 0.1f;                     // EMA weight of the newest sample
+    uint32_t hot_cell_count = 8;
+
+    std::vector<uint32_t> histogram = std::vector<uint32_t>(histogram_bins, 0);
+    std::vector<float> cell_occupancy;               // smoothed balls per cell
+    std::vector<float> stripe_time;                  // smoothed seconds per stripe per substep
+    std::vector<uint32_t> hot_cells;                 // fullest cells this frame, fullest first
+    uint32_t max_occupancy = 0;
+    float mean_occupancy   = 0.f;                    // over non-empty cells
+
+    void update(const Grid& grid)
+    {
+        if (cell_occupancy.size() != grid.cells.size())
+            cell_occupancy.assign(grid.cells.size(), 0.f);
+
+        std::fill(histogram.begin(), histogram.end(), 0);
+        max_occupancy = 0;
+        size_t occupied = 0, total = 0;
+        for (size_t idx{0}; idx < grid.cells.size(); ++idx) {
+            const uint32_t count = static_cast<uint32_t>(grid.cells[idx].getObjectCount());
+            ++histogram[std::min(count, histogram_bins - 1)];
+            max_occupancy = std::max(max_occupancy, count);
+            occupied += count > 0;
+            total    += count;
+            cell_occupancy[idx] += smoothing * (static_cast<float>(count) - cell_occupancy[idx]);
+        }
+        mean_occupancy = occupied ? static_cast<float>(total) / occupied : 0.f;
+
+        hot_cells.resize(grid.cells.size());
+        for (uint32_t idx{0}; idx < hot_cells.size(); ++idx) {
+            hot_cells[idx] = idx;
+        }
+        const size_t hot = std::min<size_t>(hot_cell_count, hot_cells.size());
+        std::partial_sort(hot_cells.begin(), hot_cells.begin() + hot, hot_cells.end(), [&grid](uint32_t a, uint32_t b) {
+            return grid.cells[a].getObjectCount() > grid.cells[b].getObjectCount();
+        });
+        hot_cells.resize(hot);
+    }
+
+    [[nodiscard]]
+    uint32_t getStripeCount(const Grid& grid) const
+    {
+        return (grid.grid_height + stripe_rows - 1) / stripe_rows;
+    }
+
+    // Called by the solver; each stripe is timed by exactly one thread
+    void recordStripeTime(uint32_t stripe, float seconds)
+    {
+        stripe_time[stripe] += smoothing * (seconds - stripe_time[stripe]);
+    }
+
+    void prepareStripes(const Grid& grid)
+    {
+        stripe_time.resize(getStripeCount(grid), 0.f);
+    }
+
+    // Slowest stripe over the mean stripe time; 1 means perfectly balanced
+    [[nodiscard]]
+    float getStripeImbalance() const
+    {
+        if (stripe_time.empty())
+            return 1.f;
+        float sum = 0.f, slowest = 0.f;
+        for (const float time : stripe_time) {
+            sum += time;
+            slowest = std::max(slowest, time);
+        }
+        return sum > 0.f ? slowest * stripe_time.size() / sum : 1.f;
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#define HAVE_SFML
+#include "../utils/math.h"
+#include "verlet.h"
+
+
+// Static collider. Every shape is a capsule: a segment is a capsule with zero radius and
+// a circle is a capsule whose end points coincide.
+struct Obstacle {
+    sf::Vector2f start = {0.f, 0.f};
+    sf::Vector2f end   = {0.f, 0.f};
+    float radius       = 0.f;
+
+    static Obstacle segment(sf::Vector2f start, sf::Vector2f end)
+    {
+        return {start, end, 0.f};
+    }
+
+    static Obstacle capsule(sf::Vector2f start, sf::Vector2f end, float radius)
+    {
+        return {start, end, radius};
+    }
+
+    static Obstacle circle(sf::Vector2f center, float radius)
+    {
+        return {center, center, radius};
+    }
+
+    [[nodiscard]]
+    sf::Vector2f closestPoint(const sf::Vector2f& point) const
+    {
+        const sf::Vector2f axis = end - start;
+        const float length2     = utils::dot(axis, axis);
+        if (length2 < EPSILON)
+            return start;
+        const float t = std::clamp(utils::dot(point - start, axis) / length2, 0.f, 1.f);
+        return start + axis * t;
+    }
+
+    // True when the move from `from` to `to` crosses the capsule axis
+    [[nodiscard]]
+    bool isCrossedBy(const sf::Vector2f& from, const sf::Vector2f& to) const
+    {
+        auto cross = [](const sf::Vector2f& a, const sf::Vector2f& b) { return a.x * b.y - a.y * b.x; };
+        const sf::Vector2f axis = end - start;
+        const sf::Vector2f move = to - from;
+        const float denom = cross(move, axis);
+        if (std::abs(denom) < EPSILON)
+            return false;
+        const float t = cross(start - from, axis) / denom;
+        const float u = cross(start - from, move) / denom;
+        return t > 0.f && t <= 1.f && u >= 0.f && u <= 1.f;
+    }
+};
+
+
+// Obstacles rasterised once into a uniform grid. Each cell lists every obstacle that a ball
+// centred anywhere in that cell (with radius up to max_ball_radius) could touch, so the
+// narrow phase only looks at the ball's own cell. Cells are stored flat: the obstacles of
+// cell i are refs[offsets[i] .. offsets[i + 1]).
+class ObstacleGrid {
+public:
+    std::vector<Obstacle> obstacles;
+
+    ObstacleGrid(uint32_t w, uint32_t h, float cs = 25.f, float max_ball_radius = 8.f)
+        : world_width(w), world_height(h), max_ball_radius(max_ball_radius)
+    {
+        resize(cs);
+    }
+
+    void resize(float cs)
+    {
+        cell_size   = cs;
+        grid_width  = static_cast<uint32_t>(std::ceil(world_width  / cell_size));
+        grid_height = static_cast<uint32_t>(std::ceil(world_height / cell_size));
+        dirty = true;
+    }
+
+    void setMaxBallRadius(float radius)
+    {
+        max_ball_radius = radius;
+        dirty = true;
+    }
+
+    [[nodiscard]]
+    float getMaxBallRadius() const
+    {
+        return max_ball_radius;
+    }
+
+    void add(const Obstacle& obstacle)
+    {
+        obstacles.push_back(obstacle);
+        dirty = true;
+    }
+
+    void clear()
+    {
+        obstacles.clear();
+        dirty = true;
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return obstacles.empty();
+    }
+
+    // Rasterise pending changes; cheap when nothing changed. Must run before collide().
+    void build()
+    {
+        if (dirty)
+            rasterise();
+    }
+
+    // Push the ball out of every obstacle listed in its cell
+    void collide(VerletBall& ball) const
+    {
+        const int cell_x = static_cast<int>(ball.position.x / cell_size);
+        const int cell_y = static_cast<int>(ball.position.y / cell_size);
+        if (cell_x < 0 || cell_y < 0 || cell_x >= static_cast<int>(grid_width) || cell_y >= static_cast<int>(grid_height))
+            return;
+
+        const uint32_t cell = cell_y * grid_width + cell_x;
+        for (uint32_t i{offsets[cell]}; i < offsets[cell + 1]; ++i) {
+            const Obstacle& obstacle   = obstacles[refs[i]];
+            const sf::Vector2f closest = obstacle.closestPoint(ball.position);
+            const sf::Vector2f delta   = ball.position - closest;
+            const float dist2          = delta.x * delta.x + delta.y * delta.y;
+            const float min_dist       = ball.radius + obstacle.radius;
+
+            // A ball that stepped across a thin wall goes back to the side it came from
+            if (obstacle.isCrossedBy(ball.previous_position, ball.position) && dist2 > EPSILON) {
+                ball.position = closest - delta * (min_dist / std::sqrt(dist2));
+            } else if (dist2 < min_dist * min_dist && dist2 > EPSILON) {
+                const float dist = std::sqrt(dist2);
+                ball.position += delta * ((min_dist - dist) / dist);
+            }
+        }
+    }
+
+private:
+    uint32_t world_width, world_height;
+    uint32_t grid_width  = 0;
+    uint32_t grid_height = 0;
+    float cell_size      = 25.f;
+    float max_ball_radius;
+    bool dirty = true;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> refs;
+
+    // Two passes over the covered cells: count, then fill
+    void rasterise()
+    {
+        offsets.assign(grid_width * grid_height + 1, 0);
+        forEachCoveredCell([this](uint32_t cell, uint32_t) { ++offsets[cell + 1]; });
+        for (size_t i{1}; i < offsets.size(); ++i) {
+            offsets[i] += offsets[i - 1];
+        }
+
+        refs.resize(offsets.back());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        forEachCoveredCell([this, &cursor](uint32_t cell, uint32_t obstacle_idx) {
+            refs[cursor[cell]++] = obstacle_idx;
+        });
+        dirty = false;
+    }
+
+    // A cell is covered when its centre is within reach of the capsule axis, where reach adds
+    // the largest ball radius and the half diagonal of the cell
+    template <typename F>
+    void forEachCoveredCell(F&& fn) const
+    {
+        const float half_diagonal = cell_size * 0.70710678f;
+        for (uint32_t idx{0}; idx < obstacles.size(); ++idx) {
+            const Obstacle& obstacle = obstacles[idx];
+            const float reach = obstacle.radius + max_ball_radius + half_diagonal;
+            const int x0 = std::max(0, static_cast<int>((std::min(obstacle.start.x, obstacle.end.x) - reach) / cell_size));
+            const int y0 = std::max(0, static_cast<int>((std::min(obstacle.start.y, obstacle.end.y) - reach) / cell_size));
+            const int x1 = std::min(static_cast<int>(grid_width)  - 1, static_cast<int>((std::max(obstacle.start.x, obstacle.end.x) + reach) / cell_size));
+            const int y1 = std::min(static_cast<int>(grid_height) - 1, static_cast<int>((std::max(obstacle.start.y, obstacle.end.y) + reach) / cell_size));
+            for (int y{y0}; y <= y1; ++y) {
+                for (int x{x0}; x <= x1; ++x) {
+                    const sf::Vector2f center((x + 0.5f) * cell_size, (y + 0.5f) * cell_size);
+                    const sf::Vector2f delta = center - obstacle.closestPoint(center);
+                    if (delta.x * delta.x + delta.y * delta.y <= reach * reach)
+                        fn(static_cast<uint32_t>(y) * grid_width + x, idx);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include "world.h"
+
+
+// Runs PhysicsSolver::advance on its own thread, away from any window. The solver is
+// borrowed: it must outlive the run and must not be touched until isRunning() is false or
+// wait() returns. The record callback runs on the runner thread.
+class OfflineRunner {
+public:
+    using Recorder = std::function<bool(uint32_t frame, const PhysicsSolver& solver)>;
+
+    OfflineRunner() = default;
+
+    ~OfflineRunner()
+    {
+        stop();
+    }
+
+    OfflineRunner(const OfflineRunner&) = delete;
+    OfflineRunner& operator=(const OfflineRunner&) = delete;
+
+    // Start a run; a run already in progress is stopped first
+    void start(PhysicsSolver& solver, uint32_t frames, float dt, uint32_t record_every = 0, Recorder record = nullptr)
+    {
+        stop();
+        cancel.store(false);
+        frames_done.store(0);
+        running.store(true);
+        worker = std::thread([this, &solver, frames, dt, record_every, record = std::move(record)] {
+            // Progress is published every frame through the record hook, which also checks for cancel
+            solver.advance(frames, dt, 1, [&](uint32_t frame, const PhysicsSolver& state) {
+                frames_done.store(frame, std::memory_order_relaxed);
+                if (record && record_every != 0 && frame % record_every == 0 && !record(frame, state))
+                    return false;
+                return !cancel.load(std::memory_order_relaxed);
+            });
+            running.store(false);
+        });
+    }
+
+    // Ask the run to end after the current frame and wait for it
+    void stop()
+    {
+        cancel.store(true);
+        wait();
+    }
+
+    void wait()
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    [[nodiscard]]
+    bool isRunning() const
+    {
+        return running.load();
+    }
+
+    [[nodiscard]]
+    uint32_t getFramesDone() const
+    {
+        return frames_done.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::thread worker;
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> frames_done{0};
+};
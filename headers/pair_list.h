@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "verlet_grid.h"
+
+
+struct ListedPair {
+    uint32_t a, b;
+};
+
+
+// Verlet pair list: ball pairs reused across substeps and frames.
+// Pairs closer than their contact distance plus skin are gathered from the grid once. Two
+// balls that have each moved at most skin / 2 since that gather can only touch if they are
+// in the list, so the solver walks the list for them instead of the 3x3 cell neighbourhoods.
+// Balls that moved further are "fast": their pairs in the list are skipped and the solver
+// tests them against the grid every substep. The lists are gathered again once the fast
+// balls exceed rebuild_fraction of the scene.
+// Lists are stored per chunk (one per pool worker) and hold both (a, b) and (b, a), in the
+// chunk owning a: Gauss-Seidel then visits pairs as often as the grid sweep does, and a Jacobi
+// worker only writes corrections of its own balls.
+class PairList {
+public:
+    float skin             = 2.f;    // extra search distance, pixels; contact distance + skin must fit in a grid cell
+    float rebuild_fraction = 0.2f;   // share of fast balls that triggers a new gather
+    std::vector<std::vector<ListedPair>> lists;
+
+    // Flag the fast balls; true when the lists must be gathered again (beginRebuild, then
+    // gatherPairs for every chunk)
+    bool update(const std::vector<VerletBall>& objects, size_t chunk_count)
+    {
+        fast_balls.clear();
+        if (objects.size() != anchors.size() || chunk_count != lists.size())
+            return true;
+        const float limit2 = 0.25f * skin * skin;
+        const size_t limit = static_cast<size_t>(rebuild_fraction * static_cast<float>(objects.size()));
+        for (uint32_t idx{0}; idx < objects.size(); ++idx) {
+            const sf::Vector2f moved = objects[idx].position - anchors[idx];
+            const bool moved_far = moved.x * moved.x + moved.y * moved.y > limit2;
+            fast[idx] = moved_far;
+            if (moved_far) {
+                fast_balls.push_back(idx);
+                if (fast_balls.size() > limit)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]]
+    bool isFast(uint32_t idx) const
+    {
+        return fast[idx] != 0;
+    }
+
+    [[nodiscard]]
+    const std::vector<uint32_t>& getFastBalls() const
+    {
+        return fast_balls;
+    }
+
+    // Empty the lists for gatherPairs and anchor every ball at its current position
+    void beginRebuild(const std::vector<VerletBall>& objects, size_t chunk_count)
+    {
+        lists.resize(chunk_count);
+        for (auto& list : lists) {
+            list.clear();
+        }
+        anchors.resize(objects.size());
+        for (size_t idx{0}; idx < objects.size(); ++idx) {
+            anchors[idx] = objects[idx].position;
+        }
+        fast.assign(objects.size(), 0);
+        fast_balls.clear();
+        ++rebuilds;
+    }
+
+    // Gather the pairs of balls in cell rows [row_begin, row_end) into lists[chunk]
+    void gatherPairs(const Grid& grid, const std::vector<VerletBall>& objects, size_t row_begin, size_t row_end, size_t chunk)
+    {
+        std::vector<ListedPair>& list = lists[chunk];
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        for (int y = static_cast<int>(row_begin); y < static_cast<int>(row_end); ++y) {
+            for (int x{0}; x < width; ++x) {
+                for (const uint32_t idx_a : grid.getCell(x, y).ball_indices) {
+                    const VerletBall& ballA = objects[idx_a];
+                    for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny) {
+                        for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx) {
+                            for (const uint32_t idx_b : grid.getCell(nx, ny).ball_indices) {
+                                if (idx_b == idx_a)
+                                    continue;
+                                const VerletBall& ballB  = objects[idx_b];
+                                const sf::Vector2f delta = ballB.position - ballA.position;
+                                const float reach        = ballA.radius + ballB.radius + skin;
+                                if (delta.x * delta.x + delta.y * delta.y < reach * reach)
+                                    list.push_back({idx_a, idx_b});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void clear()
+    {
+        lists.clear();
+        anchors.clear();
+        fast.clear();
+        fast_balls.clear();
+    }
+
+    // Number of times the lists were gathered from the grid
+    [[nodiscard]]
+    uint64_t getRebuildCount() const
+    {
+        return rebuilds;
+    }
+
+private:
+    std::vector<sf::Vector2f> anchors;  // positions at the last gather
+    std::vector<uint8_t> fast;          // moved more than skin / 2 since the last gather
+    std::vector<uint32_t> fast_balls;
+    uint64_t rebuilds = 0;
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "verlet.h"
+
+
+// Sort-and-sweep broad phase. Balls are kept sorted by the lower edge of their interval on
+// one axis; a sweep then only pairs balls whose intervals overlap on that axis. The first
+// build (or an axis change) uses an LSD radix sort. Later frames re-sort the previous order
+// with insertion sort, which is close to linear while balls move little between frames.
+// Balls added since the last update are sorted on their own and merged in, and removed
+// ones are filtered out, so spawning does not force a full rebuild.
+// The axis is the one with the larger position variance. It is re-checked every
+// axis_interval updates and only changes once the other axis leads by axis_hysteresis.
+class SortAndSweep {
+public:
+    uint32_t axis_interval = 16;
+    float axis_hysteresis  = 1.25f;     // variance ratio needed to switch axes
+
+    void update(const std::vector<VerletBall>& objects)
+    {
+        // Merging in more balls than are already sorted costs more than a radix rebuild
+        if (order.empty() || objects.size() > 2 * order.size()) {
+            sweep_axis   = chooseAxis(objects, 1.f);
+            axis_updates = 0;
+            rebuild(objects);
+            return;
+        }
+        if (++axis_updates >= axis_interval) {
+            axis_updates = 0;
+            const uint8_t axis = chooseAxis(objects, axis_hysteresis);
+            if (axis != sweep_axis) {
+                sweep_axis = axis;
+                rebuild(objects);
+                return;
+            }
+        }
+
+        if (objects.size() < order.size())
+            removeMissing(objects.size());
+        const size_t sorted_count = order.size();
+        for (size_t i{0}; i < sorted_count; ++i) {
+            lower[i] = lowerEdge(objects[order[i]]);
+        }
+        insertionSort();
+        if (objects.size() > sorted_count)
+            mergeNew(objects, sorted_count);
+    }
+
+    // fn(a, b) for every pair whose intervals overlap on both axes, each pair once.
+    // Bounds are read from the sorted keys and current positions, so fn may move balls.
+    template <typename F>
+    void forEachPair(const std::vector<VerletBall>& objects, F&& fn) const
+    {
+        const uint8_t other_axis = sweep_axis ^ 1;
+        for (size_t i{0}; i < order.size(); ++i) {
+            const VerletBall& ballA = objects[order[i]];
+            const float upper   = lower[i] + 2.f * ballA.radius;
+            const float other_a = coordinate(ballA, other_axis);
+            for (size_t j{i + 1}; j < order.size() && lower[j] <= upper; ++j) {
+                const VerletBall& ballB = objects[order[j]];
+                const float reach = ballA.radius + ballB.radius;
+                if (std::abs(coordinate(ballB, other_axis) - other_a) < reach)
+                    fn(order[i], order[j]);
+            }
+        }
+    }
+
+    [[nodiscard]]
+    uint8_t getAxis() const
+    {
+        return sweep_axis;
+    }
+
+private:
+    std::vector<uint32_t> order;        // ball indices sorted by lower edge
+    std::vector<float> lower;           // lower edge of order[i] on the sweep axis
+    std::vector<uint32_t> keys, scratch_keys, scratch_order;
+    std::vector<float> scratch_lower;
+    uint8_t sweep_axis    = 0;          // 0 = x, 1 = y
+    uint32_t axis_updates = 0;          // updates since the axis was last checked
+
+    static float coordinate(const VerletBall& ball, uint8_t axis)
+    {
+        return axis == 0 ? ball.position.x : ball.position.y;
+    }
+
+    float lowerEdge(const VerletBall& ball) const
+    {
+        return coordinate(ball, sweep_axis) - ball.radius;
+    }
+
+    // The other axis when its variance is more than hysteresis times the current one's
+    uint8_t chooseAxis(const std::vector<VerletBall>& objects, float hysteresis) const
+    {
+        if (objects.empty())
+            return sweep_axis;
+        double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_yy = 0.0;
+        for (const auto& obj : objects) {
+            sum_x  += obj.position.x;
+            sum_y  += obj.position.y;
+            sum_xx += static_cast<double>(obj.position.x) * obj.position.x;
+            sum_yy += static_cast<double>(obj.position.y) * obj.position.y;
+        }
+        const double n = static_cast<double>(objects.size());
+        const double var_x = sum_xx / n - (sum_x / n) * (sum_x / n);
+        const double var_y = sum_yy / n - (sum_y / n) * (sum_y / n);
+        const double current = sweep_axis == 0 ? var_x : var_y;
+        const double other   = sweep_axis == 0 ? var_y : var_x;
+        return other > current * hysteresis ? sweep_axis ^ 1 : sweep_axis;
+    }
+
+    // Order-preserving map from float to uint32 (negative values flip all bits)
+    static uint32_t sortableKey(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    // LSD radix sort, four passes of 8 bits
+    void rebuild(const std::vector<VerletBall>& objects)
+    {
+        const size_t count = objects.size();
+        order.resize(count);
+        lower.resize(count);
+        keys.resize(count);
+        scratch_keys.resize(count);
+        scratch_order.resize(count);
+        for (uint32_t idx{0}; idx < count; ++idx) {
+            order[idx] = idx;
+            keys[idx]  = sortableKey(lowerEdge(objects[idx]));
+        }
+        for (uint32_t shift{0}; shift < 32; shift += 8) {
+            uint32_t offsets[257] = {};
+            for (const uint32_t key : keys) {
+                ++offsets[((key >> shift) & 0xFF) + 1];
+            }
+            for (uint32_t bucket{1}; bucket < 257; ++bucket) {
+                offsets[bucket] += offsets[bucket - 1];
+            }
+            for (size_t i{0}; i < count; ++i) {
+                const uint32_t slot = offsets[(keys[i] >> shift) & 0xFF]++;
+                scratch_keys[slot]  = keys[i];
+                scratch_order[slot] = order[i];
+            }
+            keys.swap(scratch_keys);
+            order.swap(scratch_order);
+        }
+        for (size_t i{0}; i < count; ++i) {
+            lower[i] = lowerEdge(objects[order[i]]);
+        }
+    }
+
+    // Drop indices past count, keeping the rest in order
+    void removeMissing(size_t count)
+    {
+        size_t kept = 0;
+        for (size_t i{0}; i < order.size(); ++i) {
+            if (order[i] < count) {
+                order[kept] = order[i];
+                lower[kept] = lower[i];
+                ++kept;
+            }
+        }
+        order.resize(kept);
+        lower.resize(kept);
+    }
+
+    // Sort the balls from sorted_count on and merge them into the sorted prefix
+    void mergeNew(const std::vector<VerletBall>& objects, size_t sorted_count)
+    {
+        const size_t count = objects.size();
+        scratch_keys.clear();
+        for (size_t idx{sorted_count}; idx < count; ++idx) {
+            scratch_keys.push_back(static_cast<uint32_t>(idx));
+        }
+        std::sort(scratch_keys.begin(), scratch_keys.end(), [&](uint32_t a, uint32_t b) {
+            return lowerEdge(objects[a]) < lowerEdge(objects[b]);
+        });
+
+        scratch_order.resize(count);
+        scratch_lower.resize(count);
+        size_t a = 0, b = 0;
+        for (size_t out{0}; out < count; ++out) {
+            const float edge_b = b < scratch_keys.size() ? lowerEdge(objects[scratch_keys[b]]) : 0.f;
+            if (b == scratch_keys.size() || (a < sorted_count && lower[a] <= edge_b)) {
+                scratch_order[out] = order[a];
+                scratch_lower[out] = lower[a];
+                ++a;
+            } else {
+                scratch_order[out] = scratch_keys[b];
+                scratch_lower[out] = edge_b;
+                ++b;
+            }
+        }
+        order.swap(scratch_order);
+        lower.swap(scratch_lower);
+    }
+
+    void insertionSort()
+    {
+        for (size_t i{1}; i < order.size(); ++i) {
+            const float key      = lower[i];
+            const uint32_t index = order[i];
+            size_t j = i;
+            while (j > 0 && lower[j - 1] > key) {
+                lower[j] = lower[j - 1];
+                order[j] = order[j - 1];
+                --j;
+            }
+            lower[j] = key;
+            order[j] = index;
+        }
+    }
+};
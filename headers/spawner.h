@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "world.h"
+
+
+struct SpawnRequest {
+    float radius;
+    sf::Vector2f position;
+    float speed = 0.f;
+    float angle = 0.f;
+    sf::Color color = sf::Color(0, 176, 255);   // VerletBall default
+};
+
+
+// Adds queued balls over as many frames as needed instead of all at once. Each step() adds
+// balls while its time budget lasts, keeping room for the relaxation passes that follow, which
+// push overlapping balls apart without advancing time. Passes left over when the budget runs
+// out continue on the next steps. For a scene start, hold off solver updates until isIdle() so
+// the simulation begins from a relaxed scene rather than an overlapping pile.
+class Spawner {
+public:
+    float time_budget         = 0.004f;  // seconds per step, spawning and relaxing
+    uint32_t relax_iterations = 4;       // relaxation passes owed after each batch
+    uint32_t batch_size       = 256;     // balls added between clock reads
+
+    // Queue the balls of a scene; reserves the solver for everything queued so far
+    void push(PhysicsSolver& solver, const std::vector<SpawnRequest>& requests)
+    {
+        queue.insert(queue.end(), requests.begin(), requests.end());
+        float min_radius = 0.f;
+        for (size_t idx{next}; idx < queue.size(); ++idx) {
+            min_radius = min_radius > 0.f ? std::min(min_radius, queue[idx].radius) : queue[idx].radius;
+        }
+        solver.reserve(static_cast<int>(solver.getObjectCount() + getPending()), min_radius);
+    }
+
+    // Spend up to time_budget adding queued balls and relaxing. Returns the number of balls added.
+    uint32_t step(PhysicsSolver& solver)
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        const auto elapsed = [&start] {
+            return std::chrono::duration<float>(Clock::now() - start).count();
+        };
+
+        // Leave time for the passes a new batch owes; a step adds at least one batch
+        uint32_t added = 0;
+        const float spawn_budget = time_budget - relax_seconds * static_cast<float>(relax_iterations);
+        while (next < queue.size() && (added == 0 || elapsed() < spawn_budget)) {
+            const size_t end = std::min(queue.size(), next + batch_size);
+            for (; next < end; ++next) {
+                const SpawnRequest& request = queue[next];
+                VerletBall& obj = solver.addObject(request.radius, request.position, request.speed, request.angle);
+                obj.color = request.color;
+                ++added;
+            }
+        }
+        if (next == queue.size()) {
+            queue.clear();
+            next = 0;
+        }
+
+        if (added > 0)
+            relax_pending = relax_iterations;
+        while (relax_pending > 0 && elapsed() < time_budget) {
+            const auto relax_start = Clock::now();
+            solver.relax(1);
+            relax_seconds = std::chrono::duration<float>(Clock::now() - relax_start).count();
+            --relax_pending;
+        }
+        return added;
+    }
+
+    // Drop everything queued and any relaxation owed, e.g. when the scene is reset
+    void clear()
+    {
+        queue.clear();
+        next          = 0;
+        relax_pending = 0;
+    }
+
+    [[nodiscard]]
+    size_t getPending() const
+    {
+        return queue.size() - next;
+    }
+
+    // Nothing queued and no relaxation owed
+    [[nodiscard]]
+    bool isIdle() const
+    {
+        return getPending() == 0 && relax_pending == 0;
+    }
+
+private:
+    std::vector<SpawnRequest> queue;
+    size_t next            = 0;
+    uint32_t relax_pending = 0;
+    float relax_seconds    = 0.f;   // cost of the last relaxation pass
+};
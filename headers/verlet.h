@@ -15,6 +15,7 @@ constexpr float SCALE                = 100.f;    // 1 meter = 100 pixels
 constexpr float RESTITUTION          = 0.6f;     // Energy retention coefficient/response coefficient (0-1)
 constexpr float FRICTION_COEFFICIENT = 0.1f;     // Friction coefficient for floor contact
 constexpr float EPSILON              = 1e-4f;    // tolerance
+constexpr float DAMPING              = 20.f;     // velocity damping (1/s)
 constexpr float deltaTime = 1.f / static_cast<float>(frameRate);
 
 
@@ -36,12 +37,11 @@ struct VerletBall
     }
 
     // x(n+1) = 2 * x(n) - x(n-1) + a * dt^2
-    void updatePosition(float dt) 
+    void updatePosition(float dt, const sf::Vector2f& extra_acceleration = {0.f, 0.f}, float damping = DAMPING) 
     {
-        const float DAMPING = 20.f;
         const sf::Vector2f last_update_move = position - previous_position;
         sf::Vector2f temp_position = position;
-        position = 2.f * position - previous_position + (acceleration - last_update_move * DAMPING) * (dt * dt);
+        position = 2.f * position - previous_position + (acceleration + extra_acceleration - last_update_move * damping) * (dt * dt);
         previous_position = temp_position;
     }
 
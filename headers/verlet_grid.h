@@ -5,6 +5,7 @@
 #include <cmath>
 #include <memory>
 #include <array>
+#include <limits>
 #define HAVE_SFML
 #include "../utils/math.h"
 #include "../utils/constants.h"
@@ -46,6 +47,24 @@ struct Grid {
         cells.resize(grid_width * grid_height);
     }
 
+    // Change the cell size at run time; the grid is empty afterwards
+    void resize(float cs)
+    {
+        cell_size   = cs;
+        grid_width  = static_cast<uint32_t>(std::ceil(window_width / cell_size));
+        grid_height = static_cast<uint32_t>(std::ceil(window_height / cell_size));
+        clear();
+        cells.resize(grid_width * grid_height);
+    }
+
+    // Room for per_cell balls in every cell, so filling the grid does not reallocate
+    void reserve(size_t per_cell)
+    {
+        for (auto& cell : cells) {
+            cell.ball_indices.reserve(per_cell);
+        }
+    }
+
     // Debug function
     size_t getTotalBallInGrid() const
     {
@@ -84,6 +103,49 @@ struct Grid {
         return cells[cell_y * grid_width + cell_x];
     }
 
+    const Cell& getCell(const int& cell_x, const int& cell_y) const
+    {
+        return cells[cell_y * grid_width + cell_x];
+    }
+
+
+    // Visit the cells crossed by the segment from -> to in order (Amanatides-Woo DDA).
+    // fn(cell_x, cell_y) returns false to stop the walk early.
+    template <typename F>
+    void forEachCellOnSegment(const sf::Vector2f& from, const sf::Vector2f& to, F&& fn) const
+    {
+        int x = static_cast<int>(std::floor(from.x / cell_size));
+        int y = static_cast<int>(std::floor(from.y / cell_size));
+        const int end_x = static_cast<int>(std::floor(to.x / cell_size));
+        const int end_y = static_cast<int>(std::floor(to.y / cell_size));
+        const sf::Vector2f dir = to - from;
+        const int step_x = dir.x > 0.f ? 1 : -1;
+        const int step_y = dir.y > 0.f ? 1 : -1;
+
+        // Parametric distance to the first boundary crossing and between crossings
+        const float inf = std::numeric_limits<float>::infinity();
+        const float next_x = (x + (step_x > 0 ? 1 : 0)) * cell_size;
+        const float next_y = (y + (step_y > 0 ? 1 : 0)) * cell_size;
+        float t_max_x = dir.x != 0.f ? (next_x - from.x) / dir.x : inf;
+        float t_max_y = dir.y != 0.f ? (next_y - from.y) / dir.y : inf;
+        const float t_delta_x = dir.x != 0.f ? cell_size / std::abs(dir.x) : inf;
+        const float t_delta_y = dir.y != 0.f ? cell_size / std::abs(dir.y) : inf;
+
+        const uint32_t max_steps = std::abs(end_x - x) + std::abs(end_y - y) + 1;
+        for (uint32_t step{0}; step < max_steps; ++step) {
+            if (x >= 0 && y >= 0 && x < static_cast<int>(grid_width) && y < static_cast<int>(grid_height)) {
+                if (!fn(x, y))
+                    return;
+            }
+            if (t_max_x < t_max_y) {
+                x += step_x;
+                t_max_x += t_delta_x;
+            } else {
+                y += step_y;
+                t_max_y += t_delta_y;
+            }
+        }
+    }
 
     void addBall(uint32_t ball_idx, const VerletBall& ball) 
     {
@@ -1,28 +1,130 @@
 #pragma once
+#include <algorithm>
 #include "verlet_grid.h"
+#include "obstacles.h"
+#include "constraints.h"
+#include "force_field.h"
+#include "grid_stats.h"
+#include "sort_and_sweep.h"
+#include "pair_list.h"
+#include <chrono>
 #include "../src/rainbow.h"
+#include "../utils/thread_pool.h"
+#include "../utils/metrics.h"
 
 
 
 
+// Error metrics of the last frame, used to pick the next frame's substep count
+struct SubStepMetrics {
+    uint32_t sub_steps     = 1;
+    float max_displacement = 0.f; // largest per-substep move, in ball radii
+    float max_penetration  = 0.f; // deepest overlap found by resolveCollisions, in contact distances
+    float collision_time   = 0.f; // seconds spent in resolveCollisions per substep
+};
+
+
+// GaussSeidel resolves each pair in place in cell order (serial).
+// Jacobi gathers corrections from frozen positions into a per-ball buffer, then applies them,
+// so both passes can run in parallel without locks.
+enum class SolverMode : uint8_t {
+    GaussSeidel,
+    Jacobi
+};
+
+
+// Grid tests each ball against its 3x3 cell neighbourhood. SortAndSweep pairs balls whose
+// intervals overlap on the sorted axis, which suits mostly empty worlds with dense clusters.
+// Both work with either solver mode; the grid is still built for CCD and the force field.
+enum class BroadPhase : uint8_t {
+    Grid,
+    SortAndSweep
+};
+
+
+// Parameters that used to be compile-time constants, settable per solver instance
+struct SolverConfig {
+    float restitution  = RESTITUTION;
+    float damping      = DAMPING;
+    uint32_t sub_steps = 1;
+};
+
+
 class PhysicsSolver {
 public:
     std::vector<VerletBall> objects;
     Grid grid;
+    ObstacleGrid obstacles;
+    ConstraintSystem constraints;
+    ForceField force_field;
     sf::Vector2f world_size;
     uint32_t sub_steps = 8;
 
+    // Axis-aligned container walls, inset by 50 from the world edges by default
+    sf::Vector2i border_top_left;
+    sf::Vector2i border_bottom_right;
+
+    // Adaptive substepping, off by default
+    bool adaptive_sub_steps     = false;
+    uint32_t min_sub_steps      = 1;
+    uint32_t max_sub_steps      = 16;
+    float target_displacement   = 0.5f;  // max radii a ball may travel per substep
+    float target_penetration    = 0.05f; // max overlap tolerated before adding a substep
+
+    SolverMode solver_mode      = SolverMode::GaussSeidel;
+    uint32_t jacobi_iterations  = 2;
+    float jacobi_relaxation     = 1.f;   // scale applied to the accumulated corrections
+    uint32_t constraint_iterations = 2;
+    BroadPhase broad_phase      = BroadPhase::Grid;
+    float restitution           = RESTITUTION;  // fraction of an overlap resolved per contact
+    float damping               = DAMPING;
+    bool use_pair_list          = false;        // grid broad phase only, see PairList
+
+    // Balls moving more than ccd_threshold radii in a substep are swept against the grid;
+    // slower balls, a settled pile included, stay on the discrete path
+    bool continuous_collision = true;
+    float ccd_threshold       = 1.f;
+
     PhysicsSolver(sf::Vector2i size)
         : grid(size.x, size.y, 8.f)
+        , obstacles(size.x, size.y, 8.f)
         , world_size(static_cast<float>(size.x), static_cast<float>(size.y))
         , sub_steps(1)
+        , border_top_left(50, 50)
+        , border_bottom_right(size.x - 50, size.y - 50)
     {
         grid.clear();
     }
 
-    void reserve(const int& res)
+    // Size the per-ball buffers for res balls, so growing the scene up to that count never
+    // reallocates mid-frame. With min_radius, grid cells also get room for the densest packing
+    // of balls that small, now and whenever the cell size changes.
+    void reserve(const int& res, float min_radius = 0.f)
     {
         objects.reserve(res);
+        corrections.reserve(res);
+        reserved_balls  = static_cast<uint32_t>(std::max(res, 0));
+        reserved_radius = min_radius;
+        reserveCells();
+    }
+
+    // Push overlapping balls apart without advancing time: no gravity or damping, and every
+    // ball keeps its velocity. Used to settle freshly spawned balls before they are simulated.
+    void relax(uint32_t iterations)
+    {
+        velocities.resize(objects.size());
+        for (size_t idx{0}; idx < objects.size(); ++idx) {
+            velocities[idx] = objects[idx].position - objects[idx].previous_position;
+        }
+        for (uint32_t n{0}; n < iterations; ++n) {
+            addObjectToGrid();
+            handleBorderCollision(border_top_left, border_bottom_right);
+            handleObstacleCollision();
+            resolveCollisions();
+        }
+        for (size_t idx{0}; idx < objects.size(); ++idx) {
+            objects[idx].previous_position = objects[idx].position - velocities[idx];
+        }
     }
 
     void setSubsSteps(const uint32_t& sub_steps)
@@ -30,102 +132,803 @@ public:
         this->sub_steps = sub_steps;
     }
 
+    void setBorder(sf::Vector2i top_left, sf::Vector2i bottom_right)
+    {
+        border_top_left     = top_left;
+        border_bottom_right = bottom_right;
+    }
+
+    // Rebuild the grid (and the obstacle grid) with a new cell size. The cell must be at
+    // least the largest contact distance, 2 * max radius, for the 3x3 neighbourhood to hold.
+    // The balls are binned again right away, so readers of the grid between updates (the
+    // renderers, density field and color modes) never see it empty.
+    void setCellSize(float cell_size)
+    {
+        grid.resize(cell_size);
+        obstacles.resize(cell_size);
+        reserveCells();
+        addObjectToGrid();
+    }
+
+    [[nodiscard]]
+    float getCellSize() const
+    {
+        return grid.cell_size;
+    }
+
+    void addObstacle(const Obstacle& obstacle)
+    {
+        obstacles.add(obstacle);
+    }
+
+    void setAdaptiveSubSteps(uint32_t min_steps, uint32_t max_steps)
+    {
+        adaptive_sub_steps = true;
+        min_sub_steps = std::max(1u, min_steps);
+        max_sub_steps = std::max(min_sub_steps, max_steps);
+    }
+
+    void setSolverMode(SolverMode mode, uint32_t iterations = 2)
+    {
+        solver_mode       = mode;
+        jacobi_iterations = std::max(1u, iterations);
+    }
+
+    void setConfig(const SolverConfig& config)
+    {
+        restitution = config.restitution;
+        damping     = config.damping;
+        sub_steps   = std::max(1u, config.sub_steps);
+    }
+
+    [[nodiscard]]
+    SolverConfig getConfig() const
+    {
+        return {restitution, damping, sub_steps};
+    }
+
+    void setBroadPhase(BroadPhase phase)
+    {
+        broad_phase = phase;
+    }
+
+    // Resolve contacts from a Verlet pair list instead of the grid neighbourhoods
+    void setPairList(bool enabled, float skin = 2.f)
+    {
+        use_pair_list  = enabled;
+        pair_list.skin = std::max(0.f, skin);
+        pair_list.clear();
+    }
+
+    [[nodiscard]]
+    const PairList& getPairList() const
+    {
+        return pair_list;
+    }
+
+    // Time the collision sweep per stripe of rows into statistics (borrowed, nullptr disables)
+    void setStatistics(GridStatistics* stats)
+    {
+        statistics = stats;
+    }
+
+    // The pool is borrowed, not owned; without one the Jacobi passes run on the calling thread
+    void setThreadPool(utils::ThreadPool* pool)
+    {
+        thread_pool = pool;
+    }
+
+    // Axis sorted by the sort-and-sweep broad phase, 0 = x, 1 = y
+    [[nodiscard]]
+    uint8_t getSweepAxis() const
+    {
+        return sort_and_sweep.getAxis();
+    }
+
+    [[nodiscard]]
+    uint32_t getSubSteps() const
+    {
+        return sub_steps;
+    }
+
+    [[nodiscard]]
+    const SubStepMetrics& getSubStepMetrics() const
+    {
+        return metrics;
+    }
+
     // add object to system from outside
     VerletBall& addObject(float radius, sf::Vector2f position, float speed, float angle)
     {
         objects.emplace_back(radius, position, speed, angle);
+        max_radius = std::max(max_radius, radius);
+        // Obstacle cells only list what balls up to their max radius can reach
+        if (radius > obstacles.getMaxBallRadius())
+            obstacles.setMaxBallRadius(radius);
         return objects.back();
     }
 
+    // Remove every ball and constraint; obstacles and settings are kept
+    void clear()
+    {
+        objects.clear();
+        constraints.clear();
+        grid.clear();
+        pair_list.clear();
+        outside_grid.clear();
+        gridded_count = 0;
+        max_radius  = 0.f;
+        last_sub_dt = 0.f;
+    }
+
+    // Balls the grid did not take at its last rebuild (too close to the world edge). Balls
+    // with an index of getGriddedCount() or more were added since and are not in it either.
+    [[nodiscard]]
+    const std::vector<uint32_t>& getOutsideGrid() const
+    {
+        return outside_grid;
+    }
+
+    [[nodiscard]]
+    size_t getGriddedCount() const
+    {
+        return gridded_count;
+    }
+
+    // Largest radius ever added
+    [[nodiscard]]
+    float getMaxRadius() const
+    {
+        return max_radius;
+    }
+
     [[nodiscard]]
     size_t getObjectCount() const
     {
         return objects.size();
     }
 
+    // Number of update() calls so far; lets render-side caches tell whether positions changed
+    [[nodiscard]]
+    uint64_t getUpdateCount() const
+    {
+        return update_count;
+    }
+
     void update(float dt)
     {
-        int margin = 50;
+        if (adaptive_sub_steps)
+            chooseSubSteps();
+
         const float sub_dt = dt / sub_steps;
+        if (last_sub_dt > 0.f && sub_dt != last_sub_dt)
+            rescaleVelocities(sub_dt / last_sub_dt);
+        last_sub_dt = sub_dt;
+
+        metrics.sub_steps        = sub_steps;
+        metrics.max_displacement = 0.f;
+        metrics.max_penetration  = 0.f;
+        float collision_time     = 0.f;
+        pair_tests               = 0;
+        uint64_t rebuild_ns      = 0;
+        // Only the substep loop counts towards SubStepNanoseconds, not the substep choice
+        const auto substeps_start = std::chrono::steady_clock::now();
         for (uint16_t n{0}; n < sub_steps; ++n) 
         {
+            const auto rebuild_start = std::chrono::steady_clock::now();
             addObjectToGrid();
+            rebuild_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - rebuild_start).count();
             updateObjects(sub_dt);
-            handleBorderCollision(sf::Vector2i(margin, margin), sf::Vector2i(1200 - margin, 1200 - margin));
+            if (continuous_collision && !fast_balls.empty())
+                handleContinuousCollisions();
+            handleBorderCollision(border_top_left, border_bottom_right);
+            handleObstacleCollision();
+            const auto collision_start = std::chrono::steady_clock::now();
             resolveCollisions();
+            collision_time += std::chrono::duration<float>(std::chrono::steady_clock::now() - collision_start).count();
+            if (!constraints.empty())
+                constraints.solve(objects, thread_pool, constraint_iterations);
         }
+        const uint64_t substep_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - substeps_start).count();
+        metrics.collision_time = collision_time / sub_steps;
+        ++update_count;
+        publishMetrics(rebuild_ns, substep_ns);
+    }
+
+    // Run frames updates back to back, independent of any window or frame limit. Grid cells
+    // and scratch buffers are members and keep their capacity between frames.
+    // record(frame, solver) is called after every record_every-th frame (0 never calls it);
+    // returning false stops the run. Returns the number of frames run.
+    template <typename F>
+    uint32_t advance(uint32_t frames, float dt, uint32_t record_every, F&& record)
+    {
+        for (uint32_t frame{1}; frame <= frames; ++frame) {
+            update(dt);
+            if (record_every != 0 && frame % record_every == 0 && !record(frame, static_cast<const PhysicsSolver&>(*this)))
+                return frame;
+        }
+        return frames;
+    }
+
+    uint32_t advance(uint32_t frames, float dt)
+    {
+        return advance(frames, dt, 0, [](uint32_t, const PhysicsSolver&) { return true; });
     }
 
 private:
+    SubStepMetrics metrics;
+    float last_sub_dt = 0.f;
+    float max_radius  = 0.f;
+    utils::ThreadPool* thread_pool = nullptr;
+    GridStatistics* statistics     = nullptr;
+    std::vector<sf::Vector2f> corrections;
+    std::vector<uint32_t> fast_balls;
+    std::vector<float> chunk_penetration;
+    SortAndSweep sort_and_sweep;
+    PairList pair_list;
+    uint64_t pair_tests = 0;          // Gauss-Seidel only; Jacobi workers count into their own slots
+    uint64_t update_count = 0;
+    uint32_t reserved_balls = 0;
+    float reserved_radius   = 0.f;
+    std::vector<sf::Vector2f> velocities;   // relax() scratch
+    std::vector<uint32_t> outside_grid;
+    size_t gridded_count = 0;
+
+    // Balls are binned by center, so a cell holds at most its area over the hexagonal
+    // packing area per ball (2 * sqrt(3) * r^2), plus a row along the edges
+    void reserveCells()
+    {
+        if (reserved_radius <= 0.f)
+            return;
+        const float per_ball = 2.f * std::sqrt(3.f) * reserved_radius * reserved_radius;
+        const float densest  = grid.cell_size * grid.cell_size / per_ball + grid.cell_size / reserved_radius;
+        grid.reserve(std::min<size_t>(reserved_balls, static_cast<size_t>(std::ceil(densest))));
+    }
+
+    template <typename F>
+    void parallelFor(size_t count, F&& fn)
+    {
+        if (thread_pool)
+            thread_pool->parallelFor(0, count, fn);
+        else
+            fn(size_t{0}, count, size_t{0});
+    }
+
+    // One registry write per counter per frame, so instrumentation stays out of the hot loops
+    void publishMetrics(uint64_t rebuild_ns, uint64_t substep_ns)
+    {
+        utils::Metrics& registry = utils::Metrics::get();
+        registry.add(utils::Counter::SubSteps, sub_steps);
+        registry.add(utils::Counter::SubStepNanoseconds, substep_ns);
+        registry.add(utils::Counter::PairTests, pair_tests);
+        registry.add(utils::Counter::GridRebuilds, sub_steps);
+        registry.add(utils::Counter::GridRebuildNanoseconds, rebuild_ns);
+        registry.set(utils::Gauge::ActiveBalls, static_cast<double>(objects.size()));
+        registry.set(utils::Gauge::SubStepsPerFrame, static_cast<double>(sub_steps));
+    }
+
+    // Pick the substep count from last frame's metrics. Displacement scales with 1/sub_steps,
+    // so the count needed to hit target_displacement is computed directly. Penetration only
+    // nudges the count by one step, and the count drops by at most one per frame.
+    void chooseSubSteps()
+    {
+        const float frame_displacement = metrics.max_displacement * static_cast<float>(metrics.sub_steps);
+        uint32_t wanted = static_cast<uint32_t>(std::ceil(frame_displacement / target_displacement));
+
+        if (metrics.max_penetration > target_penetration)
+            wanted = std::max(wanted, sub_steps + 1);
+        else if (metrics.max_penetration > 0.5f * target_penetration)
+            wanted = std::max(wanted, sub_steps);
+
+        if (wanted < sub_steps)
+            wanted = sub_steps - 1;
+        sub_steps = std::clamp(wanted, min_sub_steps, max_sub_steps);
+    }
+
+    // Verlet stores velocity implicitly as position - previous_position, which must be
+    // rescaled when the substep length changes
+    void rescaleVelocities(float ratio)
+    {
+        for (auto& obj : objects) {
+            obj.previous_position = obj.position - (obj.position - obj.previous_position) * ratio;
+        }
+    }
+
     void checkCellCollision(uint32_t ball_idx, const Cell& c) 
     {
+        pair_tests += c.getObjectCount();
         for (uint32_t i{0}; i < c.getObjectCount(); ++i) {
-            VerletBall& ballA = objects[ball_idx];
-            VerletBall& ballB = objects[c.ball_indices[i]];
-            const sf::Vector2f delta = ballB.position - ballA.position;
-            const float dist2        = delta.x * delta.x + delta.y * delta.y;
-            const float min_dist     = ballA.radius + ballB.radius;
+            collidePair(objects[ball_idx], objects[c.ball_indices[i]]);
+        }
+    }
 
-            if (dist2 < min_dist * min_dist && dist2 > EPSILON)
-            {
-                const float response_coef = RESTITUTION;
-                const float dist          = std::sqrt(dist2);
-                const float overlap       = min_dist - dist;
-                const sf::Vector2f normal = delta / dist;
+    void collidePair(VerletBall& ballA, VerletBall& ballB)
+    {
+        const sf::Vector2f delta = ballB.position - ballA.position;
+        const float dist2        = delta.x * delta.x + delta.y * delta.y;
+        const float min_dist     = ballA.radius + ballB.radius;
+
+        if (dist2 < min_dist * min_dist && dist2 > EPSILON)
+        {
+            const float response_coef = restitution;
+            const float dist          = std::sqrt(dist2);
+            const float overlap       = min_dist - dist;
+            const sf::Vector2f normal = delta / dist;
 
-                const float mass_ratioA = ballA.radius / min_dist;
-                const float mass_ratioB = ballB.radius / min_dist;
+            const float mass_ratioA = ballA.radius / min_dist;
+            const float mass_ratioB = ballB.radius / min_dist;
 
-                const sf::Vector2f correction = normal * response_coef * overlap;
-                ballA.position -= correction * mass_ratioB;
-                ballB.position += correction * mass_ratioA;
-            }
+            const sf::Vector2f correction = normal * response_coef * overlap;
+            ballA.position -= correction * mass_ratioB;
+            ballB.position += correction * mass_ratioA;
+
+            metrics.max_penetration = std::max(metrics.max_penetration, overlap / min_dist);
         }
     }
 
     void processCell(uint32_t index, const Cell& c) 
     {
+        if (c.getObjectCount() == 0)
+            return;
+        const uint32_t stride = grid.grid_width;
+        const uint32_t x = index % stride;
+        const uint32_t y = index / stride;
+        if (x == 0 || y == 0 || x + 1 >= stride || y + 1 >= grid.grid_height) {
+            processEdgeCell(x, y, c);
+            return;
+        }
+
         for(uint32_t i{0}; i < c.getObjectCount(); ++i) {
             const uint32_t ball_idx = c.ball_indices[i];
             checkCellCollision(ball_idx, grid.cells[index - 1]);
             checkCellCollision(ball_idx, grid.cells[index]);
             checkCellCollision(ball_idx, grid.cells[index + 1]);
-            checkCellCollision(ball_idx, grid.cells[index + grid.grid_height - 1]);
-            checkCellCollision(ball_idx, grid.cells[index + grid.grid_height    ]);
-            checkCellCollision(ball_idx, grid.cells[index + grid.grid_height + 1]);
-            checkCellCollision(ball_idx, grid.cells[index - grid.grid_height - 1]);
-            checkCellCollision(ball_idx, grid.cells[index - grid.grid_height    ]);
-            checkCellCollision(ball_idx, grid.cells[index - grid.grid_height + 1]);
+            checkCellCollision(ball_idx, grid.cells[index + stride - 1]);
+            checkCellCollision(ball_idx, grid.cells[index + stride    ]);
+            checkCellCollision(ball_idx, grid.cells[index + stride + 1]);
+            checkCellCollision(ball_idx, grid.cells[index - stride - 1]);
+            checkCellCollision(ball_idx, grid.cells[index - stride    ]);
+            checkCellCollision(ball_idx, grid.cells[index - stride + 1]);
+        }
+    }
+
+    // Outer ring cells only hold balls when the border is less than a cell from the world
+    // edge (large cell sizes); same neighbour order as processCell, skipping missing cells
+    void processEdgeCell(uint32_t x, uint32_t y, const Cell& c)
+    {
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        const int rows[3] = {static_cast<int>(y), static_cast<int>(y) + 1, static_cast<int>(y) - 1};
+        for(uint32_t i{0}; i < c.getObjectCount(); ++i) {
+            const uint32_t ball_idx = c.ball_indices[i];
+            for (const int ny : rows) {
+                for (int nx = static_cast<int>(x) - 1; nx <= static_cast<int>(x) + 1; ++nx) {
+                    if (nx >= 0 && ny >= 0 && nx < width && ny < height)
+                        checkCellCollision(ball_idx, grid.getCell(nx, ny));
+                }
+            }
         }
     }
 
     void resolveCollisions()
     {
+        if (broad_phase == BroadPhase::SortAndSweep) {
+            resolveCollisionsSweep();
+            return;
+        }
+        if (use_pair_list) {
+            // The pairs are gathered from 3x3 cells, which only finds every pair within contact
+            // distance plus skin while that fits in a cell; with smaller cells use the grid path
+            if (2.f * max_radius + pair_list.skin <= grid.cell_size) {
+                resolveCollisionsPairList();
+                return;
+            }
+            pair_list.clear();
+        }
+        if (solver_mode == SolverMode::Jacobi) {
+            resolveCollisionsJacobi();
+            return;
+        }
+        if (statistics) {
+            resolveCollisionsTimed();
+            return;
+        }
         for (uint32_t idx{0}; idx < grid.cells.size(); ++idx) {
             processCell(idx, grid.cells[idx]);
         }
     }
 
+    // Gauss-Seidel sweeps the pairs twice, so each pair is resolved twice per substep as on the
+    // grid, where both of its balls visit it; back to back the second push would only see what
+    // the first left and the pile ends up stiffer. Jacobi gathers the corrections in sweep order
+    // on the calling thread (a pair writes both balls) and applies them on the pool.
+    void resolveCollisionsSweep()
+    {
+        sort_and_sweep.update(objects);
+        if (solver_mode == SolverMode::GaussSeidel) {
+            for (uint32_t pass{0}; pass < 2; ++pass) {
+                sort_and_sweep.forEachPair(objects, [this](uint32_t a, uint32_t b) {
+                    ++pair_tests;
+                    collidePair(objects[a], objects[b]);
+                });
+            }
+            return;
+        }
+
+        corrections.assign(objects.size(), {0.f, 0.f});
+        for (uint32_t iteration{0}; iteration < jacobi_iterations; ++iteration) {
+            sort_and_sweep.forEachPair(objects, [this](uint32_t a, uint32_t b) {
+                pair_tests += 2;
+                const VerletBall& ballA  = objects[a];
+                const VerletBall& ballB  = objects[b];
+                const sf::Vector2f delta = ballB.position - ballA.position;
+                const float dist2        = delta.x * delta.x + delta.y * delta.y;
+                const float min_dist     = ballA.radius + ballB.radius;
+                if (dist2 < min_dist * min_dist && dist2 > EPSILON) {
+                    const float dist    = std::sqrt(dist2);
+                    const float overlap = min_dist - dist;
+                    const sf::Vector2f correction = (delta / dist) * (restitution * overlap);
+                    corrections[a] -= correction * (ballB.radius / min_dist);
+                    corrections[b] += correction * (ballA.radius / min_dist);
+                    metrics.max_penetration = std::max(metrics.max_penetration, overlap / min_dist);
+                }
+            });
+            parallelFor(objects.size(), [this](size_t begin, size_t end, size_t) {
+                for (size_t i{begin}; i < end; ++i) {
+                    objects[i].position += corrections[i] * jacobi_relaxation;
+                    corrections[i] = {0.f, 0.f};
+                }
+            });
+        }
+    }
+
+    // Slow pairs come from the pair list and only fast balls visit grid cells
+    void resolveCollisionsPairList()
+    {
+        const bool jacobi   = solver_mode == SolverMode::Jacobi;
+        const size_t chunks = jacobi && thread_pool ? thread_pool->getThreadCount() : 1;
+        if (pair_list.update(objects, chunks)) {
+            pair_list.beginRebuild(objects, chunks);
+            if (jacobi) {
+                parallelFor(grid.grid_height, [this](size_t begin, size_t end, size_t chunk) {
+                    pair_list.gatherPairs(grid, objects, begin, end, chunk);
+                });
+            } else {
+                pair_list.gatherPairs(grid, objects, 0, grid.grid_height, 0);
+            }
+        }
+
+        if (!jacobi) {
+            pair_tests += pair_list.lists[0].size();
+            for (const ListedPair& pair : pair_list.lists[0]) {
+                if (pair_list.isFast(pair.a) || pair_list.isFast(pair.b))
+                    continue;
+                VerletBall& ballA = objects[pair.a];
+                VerletBall& ballB = objects[pair.b];
+                sf::Vector2f normal;
+                float penetration;
+                const float push = pairPush(ballA, ballB, normal, penetration);
+                if (push > 0.f) {
+                    const float min_dist = ballA.radius + ballB.radius;
+                    ballA.position -= normal * (push * ballB.radius / min_dist);
+                    ballB.position += normal * (push * ballA.radius / min_dist);
+                    metrics.max_penetration = std::max(metrics.max_penetration, penetration);
+                }
+            }
+            // Resolved from both sides, as the grid sweep would
+            forEachFastPair([this](uint32_t a, uint32_t b) {
+                collidePair(objects[a], objects[b]);
+                collidePair(objects[b], objects[a]);
+            });
+            return;
+        }
+
+        corrections.assign(objects.size(), {0.f, 0.f});
+        chunk_penetration.assign(chunks, 0.f);
+        for (uint32_t iteration{0}; iteration < jacobi_iterations; ++iteration) {
+            parallelFor(pair_list.lists.size(), [this](size_t begin, size_t end, size_t chunk) {
+                float max_penetration = 0.f;
+                uint64_t tests        = 0;
+                for (size_t list{begin}; list < end; ++list) {
+                    tests += pair_list.lists[list].size();
+                    for (const ListedPair& pair : pair_list.lists[list]) {
+                        if (pair_list.isFast(pair.a) || pair_list.isFast(pair.b))
+                            continue;
+                        const VerletBall& ballA = objects[pair.a];
+                        const VerletBall& ballB = objects[pair.b];
+                        sf::Vector2f normal;
+                        float penetration;
+                        const float push = pairPush(ballA, ballB, normal, penetration);
+                        if (push > 0.f) {
+                            corrections[pair.a] -= normal * (push * ballB.radius / (ballA.radius + ballB.radius));
+                            max_penetration = std::max(max_penetration, penetration);
+                        }
+                    }
+                }
+                chunk_penetration[chunk] = std::max(chunk_penetration[chunk], max_penetration);
+                utils::Metrics::get().add(utils::Counter::PairTests, tests);
+            });
+            // Fast pairs are few; gathered serially so both balls of a pair can be written
+            forEachFastPair([this](uint32_t a, uint32_t b) {
+                const VerletBall& ballA  = objects[a];
+                const VerletBall& ballB  = objects[b];
+                const sf::Vector2f delta = ballB.position - ballA.position;
+                const float dist2        = delta.x * delta.x + delta.y * delta.y;
+                const float min_dist     = ballA.radius + ballB.radius;
+                if (dist2 < min_dist * min_dist && dist2 > EPSILON) {
+                    const float dist    = std::sqrt(dist2);
+                    const float overlap = min_dist - dist;
+                    const sf::Vector2f correction = (delta / dist) * (restitution * overlap);
+                    corrections[a] -= correction * (ballB.radius / min_dist);
+                    corrections[b] += correction * (ballA.radius / min_dist);
+                    chunk_penetration[0] = std::max(chunk_penetration[0], overlap / min_dist);
+                }
+            });
+            parallelFor(objects.size(), [this](size_t begin, size_t end, size_t) {
+                for (size_t i{begin}; i < end; ++i) {
+                    objects[i].position += corrections[i] * jacobi_relaxation;
+                    corrections[i] = {0.f, 0.f};
+                }
+            });
+        }
+        for (const float penetration : chunk_penetration) {
+            metrics.max_penetration = std::max(metrics.max_penetration, penetration);
+        }
+    }
+
+    // fn(fast, other) for each fast ball against every ball of its 3x3 cell neighbourhood,
+    // each pair once
+    template <typename F>
+    void forEachFastPair(F&& fn)
+    {
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        for (const uint32_t idx : pair_list.getFastBalls()) {
+            const sf::Vector2i cell = grid.getCellCoords(objects[idx].position.x, objects[idx].position.y);
+            for (int ny = std::max(0, cell.y - 1); ny <= std::min(height - 1, cell.y + 1); ++ny) {
+                for (int nx = std::max(0, cell.x - 1); nx <= std::min(width - 1, cell.x + 1); ++nx) {
+                    const Cell& c = grid.getCell(nx, ny);
+                    pair_tests += c.getObjectCount();
+                    for (const uint32_t other : c.ball_indices) {
+                        if (other != idx && (!pair_list.isFast(other) || other > idx))
+                            fn(idx, other);
+                    }
+                }
+            }
+        }
+    }
+
+    // Correction length for a listed pair; 0 when apart
+    float pairPush(const VerletBall& ballA, const VerletBall& ballB, sf::Vector2f& normal, float& penetration) const
+    {
+        const sf::Vector2f delta = ballB.position - ballA.position;
+        const float dist2        = delta.x * delta.x + delta.y * delta.y;
+        const float min_dist     = ballA.radius + ballB.radius;
+        if (dist2 >= min_dist * min_dist || dist2 <= EPSILON)
+            return 0.f;
+        const float dist    = std::sqrt(dist2);
+        const float overlap = min_dist - dist;
+        normal      = delta / dist;
+        penetration = overlap / min_dist;
+        return restitution * overlap;
+    }
+
+    // Same sweep as resolveCollisions, one stripe of rows at a time
+    void resolveCollisionsTimed()
+    {
+        statistics->prepareStripes(grid);
+        const uint32_t stripe_cells = statistics->stripe_rows * grid.grid_width;
+        for (uint32_t stripe{0}; stripe < statistics->getStripeCount(grid); ++stripe) {
+            const auto start = std::chrono::steady_clock::now();
+            const uint32_t end = std::min<uint32_t>((stripe + 1) * stripe_cells, static_cast<uint32_t>(grid.cells.size()));
+            for (uint32_t idx{stripe * stripe_cells}; idx < end; ++idx) {
+                processCell(idx, grid.cells[idx]);
+            }
+            statistics->recordStripeTime(stripe, std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    // Jacobi gather over whole stripes, timing each one
+    float gatherCorrectionsTimed(size_t stripe_begin, size_t stripe_end)
+    {
+        float max_penetration = 0.f;
+        for (size_t stripe{stripe_begin}; stripe < stripe_end; ++stripe) {
+            const auto start = std::chrono::steady_clock::now();
+            const size_t row_begin = stripe * statistics->stripe_rows;
+            const size_t row_end   = std::min<size_t>(row_begin + statistics->stripe_rows, grid.grid_height);
+            max_penetration = std::max(max_penetration, gatherCorrections(row_begin, row_end));
+            statistics->recordStripeTime(static_cast<uint32_t>(stripe), std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+        }
+        return max_penetration;
+    }
+
+    // Accumulate the correction of every ball in cell rows [row_begin, row_end) against
+    // its 3x3 neighbourhood. Only corrections of balls in these rows are written.
+    float gatherCorrections(size_t row_begin, size_t row_end)
+    {
+        float max_penetration = 0.f;
+        uint64_t tests   = 0;
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        for (int y = static_cast<int>(row_begin); y < static_cast<int>(row_end); ++y) {
+            for (int x{0}; x < width; ++x) {
+                const Cell& cell = grid.getCell(x, y);
+                for (const uint32_t idx_a : cell.ball_indices) {
+                    const VerletBall& ballA = objects[idx_a];
+                    sf::Vector2f correction = {0.f, 0.f};
+                    for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny) {
+                        for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx) {
+                            tests += grid.getCell(nx, ny).getObjectCount();
+                            for (const uint32_t idx_b : grid.getCell(nx, ny).ball_indices) {
+                                const VerletBall& ballB = objects[idx_b];
+                                const sf::Vector2f delta = ballB.position - ballA.position;
+                                const float dist2        = delta.x * delta.x + delta.y * delta.y;
+                                const float min_dist     = ballA.radius + ballB.radius;
+                                if (dist2 < min_dist * min_dist && dist2 > EPSILON) {
+                                    const float dist    = std::sqrt(dist2);
+                                    const float overlap = min_dist - dist;
+                                    correction -= (delta / dist) * (restitution * overlap * ballB.radius / min_dist);
+                                    max_penetration = std::max(max_penetration, overlap / min_dist);
+                                }
+                            }
+                        }
+                    }
+                    corrections[idx_a] += correction;
+                }
+            }
+        }
+        utils::Metrics::get().add(utils::Counter::PairTests, tests);
+        return max_penetration;
+    }
+
+    void resolveCollisionsJacobi()
+    {
+        corrections.assign(objects.size(), {0.f, 0.f});
+        chunk_penetration.assign(thread_pool ? thread_pool->getThreadCount() : 1, 0.f);
+
+        if (statistics)
+            statistics->prepareStripes(grid);
+
+        for (uint32_t iteration{0}; iteration < jacobi_iterations; ++iteration) {
+            if (statistics) {
+                parallelFor(statistics->getStripeCount(grid), [this](size_t begin, size_t end, size_t chunk) {
+                    chunk_penetration[chunk] = std::max(chunk_penetration[chunk], gatherCorrectionsTimed(begin, end));
+                });
+            } else {
+                parallelFor(grid.grid_height, [this](size_t begin, size_t end, size_t chunk) {
+                    chunk_penetration[chunk] = std::max(chunk_penetration[chunk], gatherCorrections(begin, end));
+                });
+            }
+            parallelFor(objects.size(), [this](size_t begin, size_t end, size_t) {
+                for (size_t i{begin}; i < end; ++i) {
+                    objects[i].position += corrections[i] * jacobi_relaxation;
+                    corrections[i] = {0.f, 0.f};
+                }
+            });
+        }
+
+        for (const float penetration : chunk_penetration) {
+            metrics.max_penetration = std::max(metrics.max_penetration, penetration);
+        }
+    }
+
     void updateObjects(float dt) 
     {
-        for(auto& obj: objects) {
-            obj.updatePosition(dt);
+        const bool has_forces = force_field.isEnabled();
+        if (has_forces)
+            force_field.compute(objects, grid, thread_pool);
+
+        const float ccd_ratio2 = ccd_threshold * ccd_threshold;
+        float max_ratio2 = 0.f;
+        fast_balls.clear();
+        for(uint32_t idx{0}; idx < objects.size(); ++idx) {
+            VerletBall& obj = objects[idx];
+            if (has_forces)
+                obj.updatePosition(dt, force_field.accelerations[idx], damping);
+            else
+                obj.updatePosition(dt, {0.f, 0.f}, damping);
+            const sf::Vector2f move = obj.position - obj.previous_position;
+            const float ratio2 = (move.x * move.x + move.y * move.y) / (obj.radius * obj.radius);
+            max_ratio2 = std::max(max_ratio2, ratio2);
+            if (ratio2 > ccd_ratio2)
+                fast_balls.push_back(idx);
         }
+        metrics.max_displacement = std::max(metrics.max_displacement, std::sqrt(max_ratio2));
     }
 
     void addObjectToGrid() 
     {
         grid.clear();
+        outside_grid.clear();
         for(uint32_t idx{0}; idx < objects.size(); ++idx) {
             VerletBall& obj = objects[idx];
             if (obj.position.x > obj.radius && obj.position.x < world_size.x - obj.radius &&
                 obj.position.y > obj.radius && obj.position.y < world_size.y - obj.radius) 
             {
-                // sf::Vector2i cell_coords = grid.getCellCoords(obj.position.x, obj.position.y);
-                // obj.color = getColorFromCell(cell_coords.x, cell_coords.y);
                 grid.addBall(idx, obj);
+            } else {
+                outside_grid.push_back(idx);
             }
         }
+        gridded_count = objects.size();
+    }
+
+    // Sweep each fast ball from previous_position to position through the cells on its path
+    // and find the first ball it would have touched. The 3x3 neighbourhood of every visited
+    // cell is tested, since a ball in the next cell over can still be within reach.
+    // At the contact both balls take the common (momentum weighted, mass ~ radius) velocity
+    // along the normal and travel with it for the rest of the substep, so the shot pushes the
+    // ball it hits instead of just stopping short.
+    void handleContinuousCollisions()
+    {
+        const int width  = static_cast<int>(grid.grid_width);
+        const int height = static_cast<int>(grid.grid_height);
+        for (const uint32_t idx : fast_balls) {
+            VerletBall& ball        = objects[idx];
+            const sf::Vector2f from = ball.previous_position;
+            const sf::Vector2f move = ball.position - from;
+            const float move2       = utils::dot(move, move);
+            float first_hit         = 1.f;
+            uint32_t hit_idx        = idx;
+
+            grid.forEachCellOnSegment(from, ball.position, [&](int cell_x, int cell_y) {
+                for (int ny = std::max(0, cell_y - 1); ny <= std::min(height - 1, cell_y + 1); ++ny) {
+                    for (int nx = std::max(0, cell_x - 1); nx <= std::min(width - 1, cell_x + 1); ++nx) {
+                        for (const uint32_t other_idx : grid.getCell(nx, ny).ball_indices) {
+                            if (other_idx == idx)
+                                continue;
+                            // Smallest t in [0, 1] with |from + t * move - other| = r + R
+                            const VerletBall& other = objects[other_idx];
+                            const sf::Vector2f offset = from - other.position;
+                            const float min_dist = ball.radius + other.radius;
+                            const float b = utils::dot(offset, move);
+                            const float c = utils::dot(offset, offset) - min_dist * min_dist;
+                            if (c <= 0.f || b >= 0.f)
+                                continue;   // already touching at the start, or moving away
+                            const float discriminant = b * b - move2 * c;
+                            if (discriminant < 0.f)
+                                continue;
+                            const float t = (-b - std::sqrt(discriminant)) / move2;
+                            if (t < first_hit) {
+                                first_hit = t;
+                                hit_idx   = other_idx;
+                            }
+                        }
+                    }
+                }
+                return true;
+            });
+
+            if (hit_idx == idx)
+                continue;
+            VerletBall& other          = objects[hit_idx];
+            const sf::Vector2f contact = from + move * first_hit;
+            const sf::Vector2f normal  = utils::normalize(other.position - contact);
+            const sf::Vector2f other_move = other.position - other.previous_position;
+            const float normal_a = utils::dot(move, normal);
+            const float normal_b = utils::dot(other_move, normal);
+            if (normal_a <= normal_b)
+                continue;   // the other ball is already moving away faster
+            const float common   = (ball.radius * normal_a + other.radius * normal_b) / (ball.radius + other.radius);
+            const sf::Vector2f new_move   = move - normal * (normal_a - common);
+            const sf::Vector2f other_kick = normal * (common - normal_b);
+            const float remaining         = 1.f - first_hit;
+
+            ball.position          = contact + new_move * remaining;
+            ball.previous_position = ball.position - new_move;
+            other.position          += other_kick * remaining;
+            other.previous_position  = other.position - (other_move + other_kick);
+        }
+    }
+
+    void handleObstacleCollision()
+    {
+        if (obstacles.empty())
+            return;
+        obstacles.build();
+        for (auto& ball : objects) {
+            obstacles.collide(ball);
+        }
     }
 
     void handleBorderCollision(const sf::Vector2i& top_left, const sf::Vector2i& bottom_right)
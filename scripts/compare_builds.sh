@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+# Build the benchmark with every CMake preset, train the PGO profile on the headless solver
+# scene, and report each configuration's speedup over plain release on the solver benchmark.
+# Usage: scripts/compare_builds.sh [ball count] [repeats]
+#   LLVM_PROFDATA  llvm-profdata binary for Clang builds (default: llvm-profdata)
+# Every mode keeps its fastest of the repeats, which filters out scheduling noise.
+set -euo pipefail
+cd "$(dirname "$0")/.."
+
+balls=${1:-25000}
+repeats=${2:-3}
+presets=(release release-native release-lto pgo-use)
+profile_dir=build/pgo-profile
+
+# Single-config generators put the binary in the build tree, multi-config ones in Release/
+binary() {
+    for candidate in "build/$1/benchmark" "build/$1/Release/benchmark" "build/$1/Release/benchmark.exe"; do
+        if [[ -x $candidate ]]; then
+            echo "$candidate"
+            return
+        fi
+    done
+    echo "benchmark binary not found for preset $1" >&2
+    exit 1
+}
+
+build() {
+    cmake --preset "$1" > /dev/null
+    cmake --build --preset "$1" --target benchmark "${@:2}"
+}
+
+for preset in release release-native release-lto pgo-generate; do
+    build "$preset"
+done
+
+# Train: stale profiles from an older build would be mixed in, so start empty
+rm -rf "$profile_dir"
+mkdir -p "$profile_dir"
+"$(binary pgo-generate)" train "$balls"
+if compgen -G "$profile_dir/*.profraw" > /dev/null; then
+    "${LLVM_PROFDATA:-llvm-profdata}" merge -o "$profile_dir/default.profdata" "$profile_dir"/*.profraw
+fi
+# The profiles changed but the sources did not: rebuild from scratch
+build pgo-use --clean-first
+
+# ms/frame per mode: the name is the first 28 columns, ms the next to last field
+results=$(mktemp)
+trap 'rm -f "$results"' EXIT
+for preset in "${presets[@]}"; do
+    for ((run = 0; run < repeats; ++run)); do
+        echo "$preset: run $((run + 1))/$repeats" >&2
+        "$(binary "$preset")" solver "$balls" | awk -v preset="$preset" '
+            $(NF - 1) ~ /^[0-9.]+$/ && $NF ~ /^[0-9.]+$/ {
+                mode = substr($0, 1, 28)
+                sub(/ +$/, "", mode)
+                printf "%s\t%s\t%s\n", preset, mode, $(NF - 1)
+            }' >> "$results"
+    done
+done
+
+echo
+echo "solver benchmark, $balls balls, best of $repeats: ms/frame (speedup over release)"
+awk -F'\t' -v order="${presets[*]}" '
+    BEGIN { count = split(order, columns, " ") }
+    {
+        key = $1 SUBSEP $2
+        if (!(key in best) || $3 < best[key]) best[key] = $3
+        if (!($2 in seen)) { seen[$2] = 1; modes[++mode_count] = $2 }
+    }
+    END {
+        printf "%-24s", "mode"
+        for (c = 1; c <= count; ++c) printf "%20s", columns[c]
+        printf "\n"
+        for (m = 1; m <= mode_count; ++m) {
+            printf "%-24s", modes[m]
+            base = best["release" SUBSEP modes[m]]
+            for (c = 1; c <= count; ++c) {
+                ms = best[columns[c] SUBSEP modes[m]]
+                printf "%12.3f (%4.2fx)", ms, base / ms
+            }
+            printf "\n"
+        }
+    }' "$results"
@@ -0,0 +1,857 @@
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#define HAVE_SFML
+#include "../utils/random.h"
+#include "../utils/thread_pool.h"
+#include "../headers/world.h"
+#include "../headers/grid_query.h"
+#include "../headers/compact_world.h"
+#include "../headers/offline_runner.h"
+#include "../headers/ensemble.h"
+#include "../headers/spawner.h"
+#include "density_renderer.h"
+#include "color_attributes.h"
+#include "culled_vertices.h"
+
+// Headless benchmarks, no window is opened.
+// Usage: benchmark <name> [ball count]
+//   solver   Gauss-Seidel vs Jacobi (serial and threaded): ms per frame and residual penetration
+//   forces   force field cost per substep (short range, far field, both) at 1/4, 1/2 and full count
+//   queries  GridQuery (radius, AABB, k-nearest, raycast, batched) against brute force scans
+//   compact  PhysicsSolver (float) vs CompactWorld (16 byte balls) at 250k, 1M and 4M balls,
+//            or at the given count only
+//   broad    grid vs sort-and-sweep collision time, from uniform to highly clustered scenes
+//   offline  600 frames through OfflineRunner, recording every 60th: frames/s vs real time
+//   contacts substeps needed for a settled pile with the grid path and with the Verlet pair list
+//            (5000 balls by default): residual overlap, kinetic energy and ms per frame for 1 to
+//            8 substeps
+//   density  DensityField build time (splat, blur, colormap) at 25k, 250k and 1M balls for
+//            several texel sizes, serial and on all hardware threads
+//   colors   ColorAttributes per mode (speed, cell, density) at 1M balls, serial and threaded,
+//            a repeated update without a solver step, and LUT vs sin getRainbow
+//   culled   CulledVertices (view culling and dense cell aggregation) vs every ball as a quad on a
+//            settled pile: vertices and ms per build, full view, zoomed in 4x and zoomed out 4x
+//   spawn    scene start at 25k and 100k balls, all balls in one frame vs the time-sliced
+//            Spawner: longest start frame and p99 (spawning plus update) against steady state
+//   train    profile-guided optimization workload: the solver scene (different seed) through
+//            Gauss-Seidel, threaded Jacobi, the pair list and sort-and-sweep, nothing timed
+//   ensemble 32 configurations (restitution x damping x substeps) of 3000 balls each, stepped
+//            on 1, 2, 4 ... hardware threads: throughput and speedup, then per-config results
+
+
+using BenchClock = std::chrono::steady_clock;
+
+static double elapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Same layout as instant_generation in grid.cpp, but with a fixed seed
+static void fillScene(PhysicsSolver& solver, uint32_t ball_count, uint64_t seed = 42)
+{
+    const utils::CounterRandom scene_random(seed);
+    std::vector<float> xs(ball_count), ys(ball_count);
+    scene_random.split(0).fillUniform(xs, 50.f, windowWidth - 50.f);
+    scene_random.split(1).fillUniform(ys, 50.f, windowHeight - 50.f);
+    solver.reserve(ball_count);
+    for (uint32_t i = 0; i < ball_count; ++i)
+    {
+        solver.addObject(2.f, {xs[i], ys[i]}, 0.f, 0.f);
+    }
+}
+
+struct SolverResult {
+    double ms_per_frame;
+    float penetration;
+};
+
+static SolverResult runSolver(SolverMode mode, uint32_t iterations, utils::ThreadPool* pool,
+                              uint32_t ball_count, uint32_t frames = 300)
+{
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    solver.setSolverMode(mode, iterations);
+    solver.setThreadPool(pool);
+    fillScene(solver, ball_count);
+
+    // Let the scene settle into a pile before timing
+    for (uint32_t i{0}; i < 60; ++i) {
+        solver.update(deltaTime);
+    }
+
+    float penetration = 0.f;
+    const auto start  = BenchClock::now();
+    for (uint32_t i{0}; i < frames; ++i) {
+        solver.update(deltaTime);
+        penetration += solver.getSubStepMetrics().max_penetration;
+    }
+    return {elapsedMs(start) / frames, penetration / frames};
+}
+
+static void benchSolver(uint32_t ball_count)
+{
+    utils::ThreadPool pool;
+    std::cout << "solver benchmark, " << ball_count << " balls, " << pool.getThreadCount() << " threads\n";
+    std::cout << std::left << std::setw(28) << "mode" << std::setw(14) << "ms/frame" << "mean max penetration\n";
+
+    auto report = [](const std::string& name, const SolverResult& result) {
+        std::cout << std::left << std::setw(28) << name << std::setw(14) << std::fixed << std::setprecision(3)
+                  << result.ms_per_frame << result.penetration << "\n";
+    };
+
+    report("gauss-seidel",             runSolver(SolverMode::GaussSeidel, 1, nullptr, ball_count));
+    report("jacobi x1 (serial)",       runSolver(SolverMode::Jacobi,      1, nullptr, ball_count));
+    report("jacobi x2 (serial)",       runSolver(SolverMode::Jacobi,      2, nullptr, ball_count));
+    report("jacobi x1 (threaded)",     runSolver(SolverMode::Jacobi,      1, &pool,   ball_count));
+    report("jacobi x2 (threaded)",     runSolver(SolverMode::Jacobi,      2, &pool,   ball_count));
+    report("jacobi x4 (threaded)",     runSolver(SolverMode::Jacobi,      4, &pool,   ball_count));
+}
+
+// Run by the pgo-generate build so the profile covers the paths benchSolver measures without
+// being fitted to its exact scene
+static void trainProfile(uint32_t ball_count)
+{
+    utils::ThreadPool pool;
+    const uint32_t frames = 240;
+    auto run = [&](const char* label, auto&& configure) {
+        PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+        configure(solver);
+        fillScene(solver, ball_count, 7);
+        const auto start = BenchClock::now();
+        solver.advance(frames, deltaTime);
+        std::cout << std::left << std::setw(28) << label << std::fixed << std::setprecision(1)
+                  << elapsedMs(start) << " ms\n";
+    };
+    std::cout << "training run, " << ball_count << " balls, " << frames << " frames per path\n";
+    run("gauss-seidel", [](PhysicsSolver&) {});
+    run("jacobi x2 (threaded)", [&](PhysicsSolver& solver) {
+        solver.setSolverMode(SolverMode::Jacobi, 2);
+        solver.setThreadPool(&pool);
+    });
+    run("pair list", [](PhysicsSolver& solver) { solver.setPairList(true); });
+    run("sort and sweep", [](PhysicsSolver& solver) { solver.setBroadPhase(BroadPhase::SortAndSweep); });
+}
+
+static void benchForces(uint32_t ball_count)
+{
+    utils::ThreadPool pool;
+    std::cout << "force field benchmark, " << pool.getThreadCount() << " threads\n";
+    std::cout << std::left << std::setw(12) << "balls" << std::setw(16) << "short ms" << std::setw(16) << "far ms" << "both ms\n";
+
+    for (const uint32_t count : {ball_count / 4, ball_count / 2, ball_count}) {
+        PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+        solver.setThreadPool(&pool);
+        fillScene(solver, count);
+        solver.update(deltaTime);
+
+        auto timeField = [&](float strength, float gravity) {
+            ForceField& field = solver.force_field;
+            field.short_range_strength = strength;
+            field.gravity_constant     = gravity;
+            const uint32_t runs = 20;
+            const auto start = BenchClock::now();
+            for (uint32_t i{0}; i < runs; ++i) {
+                field.compute(solver.objects, solver.grid, &pool);
+            }
+            return elapsedMs(start) / runs;
+        };
+
+        std::cout << std::left << std::setw(12) << count << std::fixed << std::setprecision(3)
+                  << std::setw(16) << timeField(-50.f, 0.f)
+                  << std::setw(16) << timeField(0.f, 1000.f)
+                  << timeField(-50.f, 1000.f) << "\n";
+    }
+}
+
+static void benchQueries(uint32_t ball_count)
+{
+    utils::ThreadPool pool;
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    fillScene(solver, ball_count);
+    solver.update(deltaTime);
+    const auto& objects = solver.objects;
+    const GridQuery query(solver.grid, objects);
+
+    utils::Random randomizer(7u);
+    const uint32_t query_count = 2000;
+    std::vector<sf::Vector2f> points(query_count);
+    for (auto& point : points) {
+        point = {randomizer.generateRandomFloat(60, windowWidth - 60), randomizer.generateRandomFloat(60, windowHeight - 60)};
+    }
+
+    std::cout << "query benchmark, " << ball_count << " balls, " << query_count << " queries each\n";
+    std::cout << std::left << std::setw(20) << "query" << std::setw(14) << "grid us" << std::setw(14) << "brute us" << "results match\n";
+    auto report = [](const std::string& name, double grid_ms, double brute_ms, bool match) {
+        std::cout << std::left << std::setw(20) << name << std::fixed << std::setprecision(2)
+                  << std::setw(14) << grid_ms * 1000.0 / query_count
+                  << std::setw(14) << brute_ms * 1000.0 / query_count << (match ? "yes" : "NO") << "\n";
+    };
+
+    // Radius
+    {
+        const float radius = 30.f;
+        size_t grid_hits = 0, brute_hits = 0;
+        auto start = BenchClock::now();
+        for (const auto& point : points) {
+            query.forEachInRadius(point, radius, [&](uint32_t) { ++grid_hits; });
+        }
+        const double grid_ms = elapsedMs(start);
+        start = BenchClock::now();
+        for (const auto& point : points) {
+            for (const auto& obj : objects) {
+                const sf::Vector2f d = obj.position - point;
+                brute_hits += d.x * d.x + d.y * d.y <= radius * radius;
+            }
+        }
+        report("radius 30", grid_ms, elapsedMs(start), grid_hits == brute_hits);
+    }
+
+    // AABB
+    {
+        const sf::Vector2f half(40.f, 20.f);
+        size_t grid_hits = 0, brute_hits = 0;
+        auto start = BenchClock::now();
+        for (const auto& point : points) {
+            query.forEachInAABB(point - half, point + half, [&](uint32_t) { ++grid_hits; });
+        }
+        const double grid_ms = elapsedMs(start);
+        start = BenchClock::now();
+        for (const auto& point : points) {
+            for (const auto& obj : objects) {
+                const sf::Vector2f& p = obj.position;
+                brute_hits += p.x >= point.x - half.x && p.x <= point.x + half.x && p.y >= point.y - half.y && p.y <= point.y + half.y;
+            }
+        }
+        report("aabb 80x40", grid_ms, elapsedMs(start), grid_hits == brute_hits);
+    }
+
+    // k-nearest
+    {
+        const uint32_t k = 16;
+        std::vector<uint32_t> result;
+        std::vector<float> grid_kth(query_count), brute_kth(query_count);
+        auto start = BenchClock::now();
+        for (uint32_t i{0}; i < query_count; ++i) {
+            query.kNearest(points[i], k, result);
+            grid_kth[i] = utils::norm2f(objects[result.back()].position - points[i]);
+        }
+        const double grid_ms = elapsedMs(start);
+        start = BenchClock::now();
+        std::vector<float> dist(objects.size());
+        for (uint32_t i{0}; i < query_count; ++i) {
+            for (size_t j{0}; j < objects.size(); ++j) {
+                dist[j] = utils::norm2f(objects[j].position - points[i]);
+            }
+            std::nth_element(dist.begin(), dist.begin() + (k - 1), dist.end());
+            brute_kth[i] = dist[k - 1];
+        }
+        report("k-nearest 16", grid_ms, elapsedMs(start), grid_kth == brute_kth);
+    }
+
+    // Raycast
+    {
+        std::vector<RaycastHit> grid_hits(query_count);
+        std::vector<uint32_t> brute_hits(query_count);
+        auto start = BenchClock::now();
+        for (uint32_t i{0}; i < query_count; ++i) {
+            const float angle = i * 0.618f * 2.f * PI_f;
+            grid_hits[i] = query.raycast(points[i], {std::cos(angle), std::sin(angle)}, 400.f);
+        }
+        const double grid_ms = elapsedMs(start);
+        start = BenchClock::now();
+        for (uint32_t i{0}; i < query_count; ++i) {
+            const float angle = i * 0.618f * 2.f * PI_f;
+            const sf::Vector2f dir(std::cos(angle), std::sin(angle));
+            float best = std::numeric_limits<float>::infinity();
+            brute_hits[i] = std::numeric_limits<uint32_t>::max();
+            for (uint32_t j{0}; j < objects.size(); ++j) {
+                const sf::Vector2f offset = points[i] - objects[j].position;
+                const float b = utils::dot(offset, dir);
+                const float c = utils::dot(offset, offset) - objects[j].radius * objects[j].radius;
+                const float disc = b * b - c;
+                if (disc < 0.f)
+                    continue;
+                const float t = c <= 0.f ? 0.f : -b - std::sqrt(disc);
+                if (t >= 0.f && t <= 400.f && t < best) {
+                    best = t;
+                    brute_hits[i] = j;
+                }
+            }
+        }
+        bool match = true;
+        for (uint32_t i{0}; i < query_count; ++i) {
+            match = match && grid_hits[i].index == brute_hits[i];
+        }
+        report("raycast 400", grid_ms, elapsedMs(start), match);
+    }
+
+    // Batched radius queries on the pool
+    {
+        std::vector<size_t> counts(query_count);
+        const auto start = BenchClock::now();
+        query.batch(points, &pool, [&](const sf::Vector2f& point, size_t i) {
+            query.forEachInRadius(point, 30.f, [&](uint32_t) { ++counts[i]; });
+        });
+        std::cout << std::left << std::setw(20) << "radius 30 batched" << std::fixed << std::setprecision(2)
+                  << elapsedMs(start) * 1000.0 / query_count << " us (" << pool.getThreadCount() << " threads)\n";
+    }
+}
+
+static void benchCompact(uint32_t ball_count, bool default_count)
+{
+    std::cout << "compact storage benchmark, Gauss-Seidel, 1 substep\n";
+    std::cout << std::left << std::setw(12) << "balls" << std::setw(12) << "world px" << std::setw(14) << "float ms"
+              << std::setw(14) << "compact ms" << std::setw(16) << "float B/ball" << "compact B/ball\n";
+
+    std::vector<uint32_t> counts = {250000, 1000000, 4000000};
+    if (!default_count)
+        counts = {ball_count};
+    for (const uint32_t count : counts) {
+        // Keep the density of the default scene (25k balls of radius 2 in 1100 x 1100)
+        const int side = static_cast<int>(100 + 1100 * std::sqrt(count / 25000.0));
+        const uint32_t frames = 10;
+        utils::Random randomizer(42u);
+        std::vector<sf::Vector2f> positions(count);
+        for (auto& position : positions) {
+            position = {randomizer.generateRandomFloat(50, side - 50), randomizer.generateRandomFloat(50, side - 50)};
+        }
+
+        double float_ms = 0.0;
+        size_t float_bytes = 0;
+        {
+            PhysicsSolver solver(sf::Vector2i(side, side));
+            solver.continuous_collision = false;    // CompactWorld has no CCD
+            solver.reserve(count);
+            for (const auto& position : positions) {
+                solver.addObject(2.f, position, 0.f, 0.f);
+            }
+            solver.update(deltaTime);
+            const auto start = BenchClock::now();
+            for (uint32_t i{0}; i < frames; ++i) {
+                solver.update(deltaTime);
+            }
+            float_ms    = elapsedMs(start) / frames;
+            float_bytes = sizeof(VerletBall) + sizeof(uint32_t);
+        }
+
+        double compact_ms = 0.0;
+        size_t compact_bytes = 0;
+        {
+            CompactWorld world(sf::Vector2i(side, side));
+            world.reserve(count);
+            for (const auto& position : positions) {
+                world.addObject(2.f, position, 0.f, 0.f);
+            }
+            world.update(deltaTime);
+            const auto start = BenchClock::now();
+            for (uint32_t i{0}; i < frames; ++i) {
+                world.update(deltaTime);
+            }
+            compact_ms    = elapsedMs(start) / frames;
+            compact_bytes = world.getBytesPerBall();
+        }
+
+        std::cout << std::left << std::setw(12) << count << std::setw(12) << side << std::fixed << std::setprecision(2)
+                  << std::setw(14) << float_ms << std::setw(14) << compact_ms
+                  << std::setw(16) << float_bytes << compact_bytes << "\n";
+    }
+}
+
+// clustered_fraction of the balls go into four Gaussian clusters, the rest are uniform
+static void fillClusteredScene(PhysicsSolver& solver, uint32_t ball_count, float clustered_fraction, uint64_t seed = 42)
+{
+    const utils::CounterRandom scene_random(seed);
+    std::vector<float> u0(ball_count), u1(ball_count), u2(ball_count);
+    scene_random.split(0).fillUniform(u0, 0.f, 1.f);
+    scene_random.split(1).fillUniform(u1, 0.f, 1.f);
+    scene_random.split(2).fillUniform(u2, 0.f, 1.f);
+    const sf::Vector2f centers[4] = {{300.f, 300.f}, {900.f, 350.f}, {350.f, 850.f}, {850.f, 900.f}};
+    const float sigma = 60.f;
+
+    solver.reserve(ball_count);
+    for (uint32_t i = 0; i < ball_count; ++i)
+    {
+        sf::Vector2f position;
+        if (u2[i] < clustered_fraction) {
+            // Box-Muller
+            const float r     = sigma * std::sqrt(-2.f * std::log(std::max(u0[i], 1e-7f)));
+            const float angle = 2.f * PI_f * u1[i];
+            position = centers[i % 4] + sf::Vector2f(r * std::cos(angle), r * std::sin(angle));
+        } else {
+            position = {50.f + u0[i] * (windowWidth - 100.f), 50.f + u1[i] * (windowHeight - 100.f)};
+        }
+        position.x = std::clamp(position.x, 52.f, windowWidth - 52.f);
+        position.y = std::clamp(position.y, 52.f, windowHeight - 52.f);
+        solver.addObject(2.f, position, 0.f, 0.f);
+    }
+}
+
+static void benchBroadPhase(uint32_t ball_count)
+{
+    std::cout << "broad phase benchmark, " << ball_count << " balls, collision time per substep\n";
+    std::cout << std::left << std::setw(14) << "clustered" << std::setw(14) << "grid ms" << std::setw(14) << "sweep ms" << "sweep axis\n";
+
+    for (const float fraction : {0.f, 0.5f, 0.9f, 0.99f}) {
+        auto run = [&](BroadPhase phase, uint8_t* axis) {
+            PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+            solver.setBroadPhase(phase);
+            fillClusteredScene(solver, ball_count, fraction);
+            // The first frames push the packed clusters apart; time from the same point for both
+            for (uint32_t i{0}; i < 5; ++i) {
+                solver.update(deltaTime);
+            }
+            const uint32_t frames = 30;
+            double total = 0.0;
+            for (uint32_t i{0}; i < frames; ++i) {
+                solver.update(deltaTime);
+                total += solver.getSubStepMetrics().collision_time;
+            }
+            if (axis)
+                *axis = solver.getSweepAxis();
+            return total * 1000.0 / frames;
+        };
+        uint8_t axis = 0;
+        const double grid_ms  = run(BroadPhase::Grid, nullptr);
+        const double sweep_ms = run(BroadPhase::SortAndSweep, &axis);
+        std::cout << std::left << std::setw(14) << fraction << std::fixed << std::setprecision(3)
+                  << std::setw(14) << grid_ms << std::setw(14) << sweep_ms << (axis == 0 ? "x" : "y") << "\n";
+    }
+}
+
+static void benchOffline(uint32_t ball_count)
+{
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    fillScene(solver, ball_count);
+
+    const uint32_t frames = 600;
+    std::vector<float> mean_y;
+    OfflineRunner runner;
+    const auto start = BenchClock::now();
+    runner.start(solver, frames, deltaTime, 60, [&mean_y](uint32_t, const PhysicsSolver& state) {
+        float sum = 0.f;
+        for (const auto& obj : state.objects) {
+            sum += obj.position.y;
+        }
+        mean_y.push_back(sum / state.objects.size());
+        return true;
+    });
+    runner.wait();
+    const double seconds = elapsedMs(start) / 1000.0;
+
+    std::cout << "offline benchmark, " << ball_count << " balls, " << runner.getFramesDone() << " frames\n";
+    std::cout << std::fixed << std::setprecision(1) << frames / seconds << " frames/s, "
+              << frames / seconds / frameRate << "x real time (" << frameRate << " fps)\n";
+    std::cout << "mean y every 60 frames:";
+    for (const float y : mean_y) {
+        std::cout << " " << y;
+    }
+    std::cout << "\n";
+}
+
+// Mean and worst overlap over touching pairs, in contact distances, from a fresh grid
+static void measureOverlap(PhysicsSolver& solver, double& mean_overlap, double& worst_overlap)
+{
+    Grid& grid = solver.grid;
+    grid.clear();
+    for (uint32_t idx{0}; idx < solver.objects.size(); ++idx) {
+        grid.addBall(idx, solver.objects[idx]);
+    }
+    double sum = 0.0;
+    uint64_t contacts = 0;
+    worst_overlap = 0.0;
+    for (uint32_t idx{0}; idx < solver.objects.size(); ++idx) {
+        const VerletBall& ball  = solver.objects[idx];
+        const sf::Vector2i cell = grid.getCellCoords(ball.position.x, ball.position.y);
+        for (int ny = std::max(0, cell.y - 1); ny <= std::min<int>(grid.grid_height - 1, cell.y + 1); ++ny) {
+            for (int nx = std::max(0, cell.x - 1); nx <= std::min<int>(grid.grid_width - 1, cell.x + 1); ++nx) {
+                for (const uint32_t other : grid.getCell(nx, ny).ball_indices) {
+                    const VerletBall& ballB = solver.objects[other];
+                    const float min_dist    = ball.radius + ballB.radius;
+                    const float dist        = utils::norm2f(ballB.position - ball.position);
+                    if (other <= idx || dist >= min_dist)
+                        continue;
+                    sum += (min_dist - dist) / min_dist;
+                    worst_overlap = std::max<double>(worst_overlap, (min_dist - dist) / min_dist);
+                    ++contacts;
+                }
+            }
+        }
+    }
+    mean_overlap = contacts ? sum / contacts : 0.0;
+}
+
+// A pile counts as stable when no pair overlaps by more than 10% of the contact distance and
+// the mean squared move per frame is below 0.01 px^2
+static void benchContacts(uint32_t ball_count)
+{
+    const uint32_t settle_frames  = 600;
+    const uint32_t measure_frames = 120;
+    std::cout << "pair list benchmark, " << ball_count << " balls, Gauss-Seidel, " << settle_frames
+              << " frames to settle then " << measure_frames << " measured\n";
+    std::cout << std::setw(10) << "substeps" << std::setw(8) << "list" << std::setw(12) << "ms/frame"
+              << std::setw(14) << "mean overlap" << std::setw(15) << "worst overlap" << std::setw(12) << "kinetic"
+              << std::setw(16) << "rebuilds/frame" << "\n";
+
+    // Grid path, pair list
+    const char* variants[2]  = {"off", "on"};
+    uint32_t stable_steps[2] = {0, 0};
+    for (const uint32_t steps : {1u, 2u, 3u, 4u, 6u, 8u}) {
+        for (const int variant : {0, 1}) {
+            PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+            solver.setSubsSteps(steps);
+            solver.setPairList(variant > 0);
+            fillScene(solver, ball_count);
+            solver.advance(settle_frames, deltaTime);
+
+            const uint64_t rebuilds = solver.getPairList().getRebuildCount();
+            const auto start = BenchClock::now();
+            solver.advance(measure_frames, deltaTime);
+            const double ms = elapsedMs(start) / measure_frames;
+
+            double kinetic = 0.0;
+            for (const auto& obj : solver.objects) {
+                const sf::Vector2f move = (obj.position - obj.previous_position) * static_cast<float>(steps);
+                kinetic += move.x * move.x + move.y * move.y;
+            }
+            kinetic /= solver.objects.size();
+            double mean_overlap, worst_overlap;
+            measureOverlap(solver, mean_overlap, worst_overlap);
+            if (stable_steps[variant] == 0 && worst_overlap < 0.1 && kinetic < 0.01)
+                stable_steps[variant] = steps;
+
+            std::cout << std::fixed << std::setw(10) << steps << std::setw(8) << variants[variant]
+                      << std::setprecision(2) << std::setw(12) << ms
+                      << std::setprecision(4) << std::setw(14) << mean_overlap << std::setw(15) << worst_overlap
+                      << std::setw(12) << kinetic
+                      << std::setprecision(2) << std::setw(16) << static_cast<double>(solver.getPairList().getRebuildCount() - rebuilds) / measure_frames
+                      << "\n";
+        }
+    }
+    auto describe = [](uint32_t steps) { return steps ? std::to_string(steps) : std::string("more than 8"); };
+    std::cout << "stable pile (worst overlap < 0.1, kinetic < 0.01): " << describe(stable_steps[0])
+              << " substeps without the pair list, " << describe(stable_steps[1]) << " with it\n";
+}
+
+static void benchDensity(uint32_t ball_count, bool default_count)
+{
+    std::vector<uint32_t> counts = {25000, 250000, 1000000};
+    if (!default_count)
+        counts = {ball_count};
+    utils::ThreadPool pool;
+    std::cout << "density field benchmark, ms per build (" << pool.getThreadCount() << " threads)\n";
+    std::cout << std::setw(10) << "balls" << std::setw(8) << "texel" << std::setw(12) << "texels"
+              << std::setw(12) << "serial" << std::setw(12) << "threaded" << "\n";
+    for (const uint32_t count : counts) {
+        PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+        fillScene(solver, count);
+        // Only the grid is needed, no update
+        solver.grid.clear();
+        for (uint32_t idx{0}; idx < solver.objects.size(); ++idx) {
+            solver.grid.addBall(idx, solver.objects[idx]);
+        }
+        for (const float texel : {2.f, 4.f, 8.f}) {
+            DensityField field;
+            field.texel_size = texel;
+            double ms[2] = {0.0, 0.0};
+            for (int threaded{0}; threaded < 2; ++threaded) {
+                field.setThreadPool(threaded ? &pool : nullptr);
+                field.build(solver);    // warm up, sizes the buffers
+                const uint32_t repeats = 10;
+                const auto start = BenchClock::now();
+                for (uint32_t i{0}; i < repeats; ++i) {
+                    field.build(solver);
+                }
+                ms[threaded] = elapsedMs(start) / repeats;
+            }
+            std::cout << std::fixed << std::setprecision(2) << std::setw(10) << count << std::setw(8) << texel
+                      << std::setw(12) << field.getWidth() * field.getHeight()
+                      << std::setw(12) << ms[0] << std::setw(12) << ms[1] << "\n";
+        }
+    }
+}
+
+static void benchColors(uint32_t ball_count)
+{
+    utils::ThreadPool pool;
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    fillScene(solver, ball_count);
+    solver.grid.clear();
+    for (uint32_t idx{0}; idx < solver.objects.size(); ++idx) {
+        solver.grid.addBall(idx, solver.objects[idx]);
+    }
+    std::cout << "color attribute benchmark, " << ball_count << " balls, ms per recompute ("
+              << pool.getThreadCount() << " threads)\n";
+    std::cout << std::setw(10) << "mode" << std::setw(12) << "serial" << std::setw(12) << "threaded"
+              << std::setw(12) << "unchanged" << "\n";
+    const std::pair<const char*, ColorMode> modes[] = {
+        {"speed", ColorMode::Speed}, {"cell", ColorMode::Cell}, {"density", ColorMode::Density}};
+    for (const auto& [label, mode] : modes) {
+        double ms[2] = {0.0, 0.0};
+        double unchanged_ms = 0.0;
+        for (int threaded{0}; threaded < 2; ++threaded) {
+            ColorAttributes attributes;
+            attributes.setThreadPool(threaded ? &pool : nullptr);
+            attributes.setMode(mode);
+            const uint32_t repeats = 10;
+            for (uint32_t i{0}; i <= repeats; ++i) {
+                // The first pass sizes the buffers
+                attributes.invalidate();
+                const auto start = BenchClock::now();
+                attributes.update(solver, deltaTime);
+                if (i > 0)
+                    ms[threaded] += elapsedMs(start) / repeats;
+            }
+            // Same solver state: update returns without recomputing
+            const auto start = BenchClock::now();
+            attributes.update(solver, deltaTime);
+            unchanged_ms = elapsedMs(start);
+        }
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << label << std::setw(12) << ms[0]
+                  << std::setw(12) << ms[1] << std::setw(12) << unchanged_ms << "\n";
+    }
+
+    // getRainbow through its table vs computeRainbow's three sin calls
+    uint32_t checksum = 0;
+    auto start = BenchClock::now();
+    for (uint32_t i{0}; i < ball_count; ++i) {
+        checksum += getRainbow(static_cast<float>(i) * 0.001f).r;
+    }
+    const double lut_ms = elapsedMs(start);
+    start = BenchClock::now();
+    for (uint32_t i{0}; i < ball_count; ++i) {
+        checksum += computeRainbow(static_cast<float>(i) * 0.001f).r;
+    }
+    const double sin_ms = elapsedMs(start);
+    std::cout << std::setprecision(2) << "rainbow x" << ball_count << ": table " << lut_ms << " ms, sin "
+              << sin_ms << " ms (checksum " << checksum << ")\n";
+}
+
+static void benchCulled(uint32_t ball_count)
+{
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    fillScene(solver, ball_count);
+    for (uint32_t i{0}; i < 60; ++i) {
+        solver.update(deltaTime);
+    }
+
+    struct ViewCase {
+        const char* label;
+        sf::Vector2f center;
+        sf::Vector2f size;
+        float pixel_size;   // world units per screen pixel of a 1200 px window
+    };
+    const sf::Vector2f world(windowWidth, windowHeight);
+    const sf::Vector2f middle = world / 2.f;
+    const ViewCase views[] = {
+        {"full",     middle,                                     world,       1.f},
+        {"zoom in",  {middle.x, world.y - 50.f - world.y / 8.f}, world / 4.f, 0.25f},   // bottom of the pile
+        {"zoom out", middle,                                     world * 4.f, 4.f}};
+
+    const uint32_t repeats = 20;
+    sf::VertexArray all_quads(sf::Quads);
+    double quads_ms = 0.0;
+    for (uint32_t i{0}; i <= repeats; ++i) {
+        const auto start = BenchClock::now();
+        all_quads.clear();
+        for (const VerletBall& obj : solver.objects) {
+            appendQuad(all_quads, obj, obj.color);
+        }
+        if (i > 0)
+            quads_ms += elapsedMs(start) / repeats;
+    }
+
+    std::cout << "culled render benchmark, " << ball_count << " balls, settled pile, ms per vertex build\n";
+    std::cout << std::setw(10) << "view" << std::setw(12) << "vertices" << std::setw(10) << "ms"
+              << std::setw(14) << "all quads" << std::setw(10) << "ms" << "\n";
+    for (const ViewCase& view : views) {
+        CulledVertices culled;
+        const sf::Vector2f half = view.size / 2.f;
+        double culled_ms = 0.0;
+        for (uint32_t i{0}; i <= repeats; ++i) {
+            // The first build sizes the arrays
+            const auto start = BenchClock::now();
+            culled.build(solver, view.center - half, view.center + half, view.pixel_size);
+            if (i > 0)
+                culled_ms += elapsedMs(start) / repeats;
+        }
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << view.label
+                  << std::setw(12) << culled.getVertexCount() << std::setw(10) << culled_ms
+                  << std::setw(14) << all_quads.getVertexCount() << std::setw(10) << quads_ms << "\n";
+    }
+}
+
+struct SpawnResult {
+    double start_ms;        // longest frame while the scene starts (first start_frames frames)
+    double p99_ms;          // 99th percentile over the whole run, bursts included
+    double steady_ms;
+    uint32_t fill_frames;   // frames before the first solver update
+    float first_penetration;
+};
+
+// Frame time is spawning plus the solver update; steady state is the median of the last quarter
+static SpawnResult runSpawn(uint32_t ball_count, bool sliced, uint32_t start_frames)
+{
+    const utils::CounterRandom scene_random(42);
+    std::vector<float> xs(ball_count), ys(ball_count);
+    scene_random.split(0).fillUniform(xs, 50.f, windowWidth - 50.f);
+    scene_random.split(1).fillUniform(ys, 50.f, windowHeight - 50.f);
+    std::vector<SpawnRequest> requests(ball_count);
+    for (uint32_t i{0}; i < ball_count; ++i) {
+        requests[i] = {2.f, {xs[i], ys[i]}};
+    }
+
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    Spawner spawner;
+    if (sliced)
+        spawner.push(solver, requests);
+    const uint32_t frames = 480;
+    std::vector<double> ms(frames);
+    SpawnResult result{0.0, 0.0, 0.0, 0, -1.f};
+    for (uint32_t frame{0}; frame < frames; ++frame) {
+        const auto start = BenchClock::now();
+        if (sliced && !spawner.isIdle()) {
+            // Prewarming: the solver waits until the scene is in and relaxed
+            spawner.step(solver);
+            ms[frame] = elapsedMs(start);
+            continue;
+        }
+        if (frame == 0) {
+            for (const SpawnRequest& request : requests) {
+                solver.addObject(request.radius, request.position, request.speed, request.angle);
+            }
+        }
+        solver.update(deltaTime);
+        ms[frame] = elapsedMs(start);
+        if (result.first_penetration < 0.f) {
+            result.first_penetration = solver.getSubStepMetrics().max_penetration;
+            result.fill_frames       = frame;
+        }
+    }
+    result.start_ms = *std::max_element(ms.begin(), ms.begin() + start_frames);
+    std::vector<double> sorted = ms;
+    std::sort(sorted.begin(), sorted.end());
+    result.p99_ms = sorted[sorted.size() * 99 / 100];
+    std::vector<double> tail(ms.end() - frames / 4, ms.end());
+    std::sort(tail.begin(), tail.end());
+    result.steady_ms = tail[tail.size() / 2];
+    return result;
+}
+
+static void benchSpawn(uint32_t ball_count, bool default_count)
+{
+    std::vector<uint32_t> counts = {25000, 100000};
+    if (!default_count)
+        counts = {ball_count};
+    const uint32_t start_frames = 60;
+    std::cout << "spawn benchmark, 480 frames, start = first " << start_frames << " frames\n";
+    std::cout << std::setw(10) << "balls" << std::setw(10) << "spawn" << std::setw(10) << "start ms"
+              << std::setw(10) << "p99 ms" << std::setw(12) << "steady ms" << std::setw(12) << "start/std"
+              << std::setw(13) << "prewarm" << std::setw(16) << "first overlap" << "\n";
+    for (const uint32_t count : counts) {
+        for (const bool sliced : {false, true}) {
+            const SpawnResult result = runSpawn(count, sliced, start_frames);
+            std::cout << std::fixed << std::setprecision(2) << std::setw(10) << count
+                      << std::setw(10) << (sliced ? "sliced" : "instant") << std::setw(10) << result.start_ms
+                      << std::setw(10) << result.p99_ms << std::setw(12) << result.steady_ms
+                      << std::setw(12) << result.start_ms / result.steady_ms << std::setw(13) << result.fill_frames
+                      << std::setw(16) << result.first_penetration << "\n";
+        }
+    }
+}
+
+static void fillEnsemble(Ensemble& ensemble, uint32_t ball_count)
+{
+    const float restitutions[] = {0.4f, 0.6f, 0.8f, 1.f};
+    const float dampings[]     = {10.f, 20.f};
+    const uint32_t steps[]     = {1, 2, 4, 8};
+    uint64_t seed = 42;
+    for (const float restitution : restitutions) {
+        for (const float damping : dampings) {
+            for (const uint32_t sub_steps : steps) {
+                fillScene(ensemble.add({restitution, damping, sub_steps}), ball_count, seed++);
+            }
+        }
+    }
+}
+
+static void benchEnsemble(uint32_t ball_count)
+{
+    const uint32_t frames = 120;
+    const uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "ensemble benchmark, 32 members x " << ball_count << " balls, " << frames << " frames\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "wall s" << std::setw(10) << "speedup"
+              << std::setw(18) << "M ball-frames/s" << "\n";
+
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t threads{1}; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<MemberResult> last_results;
+    double serial_seconds = 0.0;
+    for (const uint32_t threads : thread_counts) {
+        Ensemble ensemble(sf::Vector2i(windowWidth, windowHeight));
+        fillEnsemble(ensemble, ball_count);
+        utils::ThreadPool pool(threads);
+        const EnsembleSummary summary = ensemble.run(frames, deltaTime, pool);
+        if (threads == 1)
+            serial_seconds = summary.wall_seconds;
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(8) << threads << std::setw(12) << summary.wall_seconds
+                  << std::setw(10) << serial_seconds / summary.wall_seconds
+                  << std::setw(18) << summary.ball_frames / summary.wall_seconds / 1e6 << "\n";
+        last_results = ensemble.getResults();
+    }
+
+    std::cout << "\n" << std::setw(13) << "restitution" << std::setw(9) << "damping" << std::setw(10) << "substeps"
+              << std::setw(14) << "penetration" << std::setw(10) << "mean y" << std::setw(10) << "kinetic" << "\n";
+    for (const MemberResult& result : last_results) {
+        std::cout << std::setprecision(2) << std::setw(13) << result.config.restitution
+                  << std::setw(9) << result.config.damping << std::setw(10) << result.config.sub_steps
+                  << std::setprecision(4) << std::setw(14) << result.max_penetration
+                  << std::setprecision(1) << std::setw(10) << result.mean_height
+                  << std::setprecision(4) << std::setw(10) << result.kinetic_energy << "\n";
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string name    = argc > 1 ? argv[1] : "solver";
+    const uint32_t ball_count = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 25000;
+
+    if (name == "solver") {
+        benchSolver(ball_count);
+    } else if (name == "forces") {
+        benchForces(ball_count);
+    } else if (name == "queries") {
+        benchQueries(ball_count);
+    } else if (name == "offline") {
+        benchOffline(ball_count);
+    } else if (name == "broad") {
+        benchBroadPhase(ball_count);
+    } else if (name == "density") {
+        benchDensity(ball_count, argc <= 2);
+    } else if (name == "train") {
+        trainProfile(ball_count);
+    } else if (name == "culled") {
+        benchCulled(ball_count);
+    } else if (name == "spawn") {
+        benchSpawn(ball_count, argc <= 2);
+    } else if (name == "colors") {
+        benchColors(argc > 2 ? ball_count : 1000000);
+    } else if (name == "contacts") {
+        benchContacts(argc > 2 ? ball_count : 5000);
+    } else if (name == "ensemble") {
+        benchEnsemble(argc > 2 ? ball_count : 3000);
+    } else if (name == "compact") {
+        benchCompact(ball_count, argc <= 2);
+    } else {
+        std::cerr << "unknown benchmark: " << name << "\n";
+        return 1;
+    }
+    return 0;
+}
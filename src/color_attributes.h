@@ -0,0 +1,203 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "../headers/world.h"
+#include "../utils/thread_pool.h"
+#include "rainbow.h"
+
+
+// What the balls are colored by. Stored draws VerletBall::color (set once at spawn)
+enum class ColorMode : uint8_t
+{
+    Stored  = 0,
+    Speed   = 1,
+    Cell    = 2,
+    Density = 3
+};
+
+
+// Per-ball colors derived from simulation state, computed in the render stage instead of the
+// physics loop. update() does nothing unless the solver stepped, balls were added or the mode
+// changed, so a paused scene or several draws of one frame cost a single pass.
+// Speed and density first write one scalar per ball into a flat array, then a separate pass
+// turns the scalars into heat table indices and looks the colors up; the index pass runs over
+// contiguous floats and the compiler vectorizes it.
+class ColorAttributes
+{
+public:
+    float max_speed = 500.f;  // speed drawn with the last table color, pixels / s
+
+    void setMode(ColorMode new_mode)
+    {
+        mode = new_mode;
+    }
+
+    [[nodiscard]]
+    ColorMode getMode() const
+    {
+        return mode;
+    }
+
+    void cycleMode()
+    {
+        mode = static_cast<ColorMode>((static_cast<uint8_t>(mode) + 1) % 4);
+    }
+
+    // Recompute on the next update even if the solver did not step, e.g. after changing max_speed
+    void invalidate()
+    {
+        computed_mode = ColorMode::Stored;
+    }
+
+    void setThreadPool(utils::ThreadPool* pool)
+    {
+        thread_pool = pool;
+    }
+
+    // dt is the frame time the solver was last stepped with, for speeds in pixels / s
+    void update(const PhysicsSolver& solver, float dt)
+    {
+        if (mode == ColorMode::Stored)
+            return;
+        const size_t count = solver.objects.size();
+        if (mode == computed_mode && solver.getUpdateCount() == computed_update && count == computed_count)
+            return;
+        computed_mode   = mode;
+        computed_update = solver.getUpdateCount();
+        computed_count  = count;
+        ++recomputes;
+
+        values.resize(count);
+        indices.resize(count);
+        colors.resize(count);
+        switch (mode)
+        {
+            case ColorMode::Speed:   computeSpeeds(solver, dt);  break;
+            case ColorMode::Cell:    computeCells(solver);       break;
+            case ColorMode::Density: computeDensity(solver);     break;
+            case ColorMode::Stored:  break;
+        }
+        parallelFor(count, [this](size_t begin, size_t end, size_t) {
+            mapColors(begin, end);
+        });
+    }
+
+    // Colors for Renderer::setColors, nullptr in Stored mode
+    [[nodiscard]]
+    const std::vector<sf::Color>* getColors() const
+    {
+        return mode == ColorMode::Stored ? nullptr : &colors;
+    }
+
+    // Number of times update() actually recomputed the colors
+    [[nodiscard]]
+    uint64_t getRecomputeCount() const
+    {
+        return recomputes;
+    }
+
+private:
+    ColorMode mode          = ColorMode::Stored;
+    ColorMode computed_mode = ColorMode::Stored;
+    uint64_t computed_update = 0;
+    size_t computed_count    = 0;
+    uint64_t recomputes      = 0;
+    utils::ThreadPool* thread_pool = nullptr;
+    std::vector<float> values;           // per-ball scalar, 0 to 1 across the heat table
+    std::vector<int32_t> indices;
+    std::vector<sf::Color> colors;
+    ColorTable<256> heat{computeHeatColor};
+
+    template <typename F>
+    void parallelFor(size_t count, F&& fn)
+    {
+        if (thread_pool)
+            thread_pool->parallelFor(0, count, fn);
+        else
+            fn(size_t{0}, count, size_t{0});
+    }
+
+    void computeSpeeds(const PhysicsSolver& solver, float dt)
+    {
+        // previous_position is one substep back
+        const float to_unit = dt > 0.f ? static_cast<float>(solver.getSubSteps()) / (dt * max_speed) : 0.f;
+        const auto& objects = solver.objects;
+        parallelFor(objects.size(), [&](size_t begin, size_t end, size_t) {
+            for (size_t idx{begin}; idx < end; ++idx) {
+                const sf::Vector2f move = objects[idx].position - objects[idx].previous_position;
+                values[idx] = std::sqrt(move.x * move.x + move.y * move.y) * to_unit;
+            }
+        });
+    }
+
+    // Cell colors are not a ramp; they are written directly and mapColors skips them
+    void computeCells(const PhysicsSolver& solver)
+    {
+        const auto& objects = solver.objects;
+        const Grid& grid    = solver.grid;
+        parallelFor(objects.size(), [&](size_t begin, size_t end, size_t) {
+            for (size_t idx{begin}; idx < end; ++idx) {
+                const sf::Vector2i cell = grid.getCellCoords(objects[idx].position.x, objects[idx].position.y);
+                colors[idx] = getColorFromCell(cell.x, cell.y);
+            }
+        });
+    }
+
+    // Ball count of the grid cell each ball is in, relative to the fullest cell. Grid
+    // membership is from the start of the last substep; balls outside the grid count as empty.
+    void computeDensity(const PhysicsSolver& solver)
+    {
+        const Grid& grid = solver.grid;
+        std::fill(values.begin(), values.end(), 0.f);
+        size_t fullest = 1;
+        for (const Cell& cell : grid.cells) {
+            fullest = std::max(fullest, cell.getObjectCount());
+        }
+        const float to_unit = 1.f / static_cast<float>(fullest);
+        parallelFor(grid.cells.size(), [&](size_t begin, size_t end, size_t) {
+            for (size_t c{begin}; c < end; ++c) {
+                const Cell& cell  = grid.cells[c];
+                const float value = static_cast<float>(cell.getObjectCount()) * to_unit;
+                for (const uint32_t idx : cell.ball_indices) {
+                    if (idx < values.size())
+                        values[idx] = value;
+                }
+            }
+        });
+    }
+
+    void mapColors(size_t begin, size_t end)
+    {
+        if (computed_mode == ColorMode::Cell)
+            return;
+        // Same clamp and rounding as ColorTable::index; the value is clamped to [0, 1] before
+        // the conversion, so huge values and NaN never reach the int cast. Float compares
+        // only vectorize with -fno-trapping-math, so the clamp works on the bit patterns:
+        // non-negative floats order like their bits as int32, negative ones (and -NaN) are
+        // below 0 and +NaN lands above 1.f. Fixed blocks of 8 let the compiler vectorize the
+        // block at -O2, which skips loops needing a scalar tail.
+        const float* value = values.data();
+        int32_t* index     = indices.data();
+        constexpr int32_t one_bits = 0x3f800000;    // 1.f
+        size_t idx{begin};
+        for (; idx + 8 <= end; idx += 8) {
+            int32_t bits[8];
+            std::memcpy(bits, value + idx, sizeof(bits));
+            for (size_t k{0}; k < 8; ++k) {
+                const int32_t clamped = std::min(std::max(bits[k], 0), one_bits);
+                float t;
+                std::memcpy(&t, &clamped, sizeof(t));
+                index[idx + k] = static_cast<int32_t>(t * 255.f + 0.5f);
+            }
+        }
+        for (; idx < end; ++idx) {
+            index[idx] = static_cast<int32_t>(ColorTable<256>::index(value[idx]));
+        }
+        for (idx = begin; idx < end; ++idx) {
+            colors[idx] = heat.colors[index[idx]];
+        }
+    }
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <algorithm>
+#include "../headers/world.h"
+
+
+inline void appendQuad(sf::VertexArray& vertices, const VerletBall& obj, sf::Color color)
+{
+    const sf::Vector2f& p = obj.position;
+    const float r = obj.radius;
+    vertices.append(sf::Vertex({p.x - r, p.y - r}, color));
+    vertices.append(sf::Vertex({p.x + r, p.y - r}, color));
+    vertices.append(sf::Vertex({p.x + r, p.y + r}, color));
+    vertices.append(sf::Vertex({p.x - r, p.y + r}, color));
+}
+
+
+// Vertices of the balls inside a view rectangle, gathered from the grid cells overlapping it.
+// Cells holding at least density_threshold balls become a single quad in the cell's mean color
+// as long as the cell is at most max_aggregate_pixels wide on screen, and balls smaller than a
+// pixel become points. Balls the grid does not hold (at the world edge, or added since the last
+// update) are tested against the view one by one and drawn the same way.
+// The arrays are kept between builds so a steady scene does not reallocate every frame.
+class CulledVertices
+{
+public:
+    uint32_t density_threshold = 4;
+    float max_aggregate_pixels = 8.f;
+
+    sf::VertexArray quads{sf::Quads};
+    sf::VertexArray points{sf::Points};
+
+    // pixel_size is the world size of one screen pixel; colors as in Renderer::setColors
+    void build(const PhysicsSolver& solver, sf::Vector2f top_left, sf::Vector2f bottom_right,
+               float pixel_size, const std::vector<sf::Color>* colors = nullptr)
+    {
+        const auto& objects = solver.objects;
+        const Grid& grid    = solver.grid;
+        const bool can_aggregate = grid.cell_size <= max_aggregate_pixels * pixel_size;
+        const auto colorOf = [colors](const VerletBall& obj, size_t idx) {
+            return colors ? (*colors)[idx] : obj.color;
+        };
+        const auto appendBall = [&](const VerletBall& obj, size_t idx) {
+            if (obj.radius < pixel_size)
+                points.append(sf::Vertex(obj.position, colorOf(obj, idx)));
+            else
+                appendQuad(quads, obj, colorOf(obj, idx));
+        };
+        quads.clear();
+        points.clear();
+
+        // Expand by one cell: grid membership is from the start of the last substep
+        const int x0 = std::max(0, static_cast<int>(top_left.x / grid.cell_size) - 1);
+        const int y0 = std::max(0, static_cast<int>(top_left.y / grid.cell_size) - 1);
+        const int x1 = std::min(static_cast<int>(grid.grid_width)  - 1, static_cast<int>(bottom_right.x / grid.cell_size) + 1);
+        const int y1 = std::min(static_cast<int>(grid.grid_height) - 1, static_cast<int>(bottom_right.y / grid.cell_size) + 1);
+
+        for (int y{y0}; y <= y1; ++y) {
+            for (int x{x0}; x <= x1; ++x) {
+                const Cell& cell = grid.getCell(x, y);
+                const size_t count = cell.getObjectCount();
+                if (count == 0)
+                    continue;
+
+                if (can_aggregate && count >= density_threshold) {
+                    uint32_t r = 0, g = 0, b = 0;
+                    for (const uint32_t idx : cell.ball_indices) {
+                        const sf::Color color = colorOf(objects[idx], idx);
+                        r += color.r;
+                        g += color.g;
+                        b += color.b;
+                    }
+                    const sf::Color mean(static_cast<uint8_t>(r / count),
+                                         static_cast<uint8_t>(g / count),
+                                         static_cast<uint8_t>(b / count));
+                    const float left = x * grid.cell_size;
+                    const float top  = y * grid.cell_size;
+                    const float size = grid.cell_size;
+                    quads.append(sf::Vertex({left,        top},        mean));
+                    quads.append(sf::Vertex({left + size, top},        mean));
+                    quads.append(sf::Vertex({left + size, top + size}, mean));
+                    quads.append(sf::Vertex({left,        top + size}, mean));
+                    continue;
+                }
+
+                for (const uint32_t idx : cell.ball_indices) {
+                    appendBall(objects[idx], idx);
+                }
+            }
+        }
+
+        const auto isVisible = [&](const VerletBall& obj) {
+            return obj.position.x + obj.radius >= top_left.x && obj.position.x - obj.radius <= bottom_right.x &&
+                   obj.position.y + obj.radius >= top_left.y && obj.position.y - obj.radius <= bottom_right.y;
+        };
+        for (const uint32_t idx : solver.getOutsideGrid()) {
+            if (idx < objects.size() && isVisible(objects[idx]))
+                appendBall(objects[idx], idx);
+        }
+        for (size_t idx{solver.getGriddedCount()}; idx < objects.size(); ++idx) {
+            if (isVisible(objects[idx]))
+                appendBall(objects[idx], idx);
+        }
+    }
+
+    [[nodiscard]]
+    size_t getVertexCount() const
+    {
+        return quads.getVertexCount() + points.getVertexCount();
+    }
+};
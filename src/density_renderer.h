@@ -0,0 +1,314 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "../headers/world.h"
+#include "../utils/thread_pool.h"
+
+
+// Low resolution density field of the balls, for fluid-looking output. Each ball adds its
+// area to the 4 nearest texels (bilinear splat), the field is blurred with a separable
+// Gaussian and mapped through a 256 entry color table into RGBA pixels.
+// The splat runs in horizontal bands, one per pool chunk. A band only reads the grid rows
+// that can reach it and only writes its own texel rows, so no locks are needed. Crowded
+// cells are splatted from their ball count alone, spread over the texels the cell covers,
+// so dense scenes cost per cell rather than per ball; blur and colormap cost per texel.
+class DensityField {
+public:
+    float texel_size   = 4.f;   // world pixels per texel
+    float blur_sigma   = 1.5f;  // texels
+    float full_density = 0.9f;  // covered area fraction mapped to the top of the color table
+    float threshold    = 0.f;   // > 0: texels below it are transparent and the rest opaque (metaball look)
+    uint32_t aggregate_count = 8;   // cells with at least this many balls skip reading them (0 never does)
+
+    DensityField()
+    {
+        setColormap([](float t) {
+            // Deep blue -> cyan -> white
+            const float r = std::clamp(2.f * t - 1.f, 0.f, 1.f);
+            const float g = std::clamp(1.5f * t - 0.1f, 0.f, 1.f);
+            const float b = std::clamp(0.4f + 1.2f * t, 0.f, 1.f);
+            return sf::Color(static_cast<uint8_t>(255.f * r), static_cast<uint8_t>(255.f * g), static_cast<uint8_t>(255.f * b));
+        });
+    }
+
+    // Sample fn(t), t in [0, 1], into the color table
+    template <typename F>
+    void setColormap(F&& fn)
+    {
+        for (uint32_t i{0}; i < 256; ++i) {
+            colormap[i] = fn(static_cast<float>(i) / 255.f);
+        }
+    }
+
+    // The pool is borrowed; without one every pass runs on the calling thread
+    void setThreadPool(utils::ThreadPool* pool)
+    {
+        thread_pool = pool;
+    }
+
+    // Splat, blur and colormap the current state into getPixels()
+    void build(const PhysicsSolver& solver)
+    {
+        resize(solver.world_size);
+        std::fill(density.begin(), density.end(), 0.f);
+        parallelFor(height, [&](size_t begin, size_t end, size_t) {
+            splatRows(solver, begin, end);
+        });
+        blur();
+        parallelFor(height, [this](size_t begin, size_t end, size_t) {
+            colorRows(begin, end);
+        });
+    }
+
+    [[nodiscard]]
+    const std::vector<uint8_t>& getPixels() const
+    {
+        return pixels;
+    }
+
+    [[nodiscard]]
+    const std::vector<float>& getDensity() const
+    {
+        return density;
+    }
+
+    [[nodiscard]]
+    uint32_t getWidth() const
+    {
+        return width;
+    }
+
+    [[nodiscard]]
+    uint32_t getHeight() const
+    {
+        return height;
+    }
+
+private:
+    uint32_t width  = 0;
+    uint32_t height = 0;
+    std::vector<float> density;
+    std::vector<float> scratch;
+    std::vector<float> kernel;      // half Gaussian, kernel[0] is the center weight
+    std::vector<uint8_t> pixels;    // RGBA, width * height * 4
+    sf::Color colormap[256];
+    float kernel_sigma = -1.f;      // sigma the kernel was built for
+    utils::ThreadPool* thread_pool = nullptr;
+
+    template <typename F>
+    void parallelFor(size_t count, F&& fn)
+    {
+        if (thread_pool)
+            thread_pool->parallelFor(0, count, fn);
+        else
+            fn(size_t{0}, count, size_t{0});
+    }
+
+    void resize(sf::Vector2f world_size)
+    {
+        const uint32_t w = std::max(1u, static_cast<uint32_t>(std::ceil(world_size.x / texel_size)));
+        const uint32_t h = std::max(1u, static_cast<uint32_t>(std::ceil(world_size.y / texel_size)));
+        if (w != width || h != height) {
+            width  = w;
+            height = h;
+            density.assign(static_cast<size_t>(width) * height, 0.f);
+            scratch.assign(density.size(), 0.f);
+            pixels.assign(density.size() * 4, 0);
+        }
+        if (blur_sigma != kernel_sigma) {
+            kernel_sigma = blur_sigma;
+            const int radius = std::max(0, static_cast<int>(std::ceil(2.5f * blur_sigma)));
+            kernel.assign(radius + 1, 1.f);
+            float sum = 0.f;
+            for (int k{0}; k <= radius; ++k) {
+                kernel[k] = blur_sigma > 0.f ? std::exp(-0.5f * k * k / (blur_sigma * blur_sigma)) : 1.f;
+                sum += k == 0 ? kernel[k] : 2.f * kernel[k];
+            }
+            for (float& weight : kernel) {
+                weight /= sum;
+            }
+        }
+    }
+
+    // Splat the balls whose footprint touches texel rows [row_begin, row_end)
+    void splatRows(const PhysicsSolver& solver, size_t row_begin, size_t row_end)
+    {
+        const Grid& grid = solver.grid;
+        const auto& objects = solver.objects;
+        const float inv_texel  = 1.f / texel_size;
+        const float texel_area = texel_size * texel_size;
+        const float max_radius = solver.getMaxRadius();
+        const float ball_mass  = PI_f * max_radius * max_radius / texel_area;
+        // One extra cell row each way: grid membership is from the start of the last substep
+        const int cell_begin = std::max(0, static_cast<int>((row_begin * texel_size - texel_size) / grid.cell_size) - 1);
+        const int cell_end   = std::min(static_cast<int>(grid.grid_height) - 1, static_cast<int>((row_end * texel_size + texel_size) / grid.cell_size) + 1);
+        const int first_row  = static_cast<int>(row_begin);
+        const int last_row   = static_cast<int>(row_end) - 1;
+
+        for (int cy{cell_begin}; cy <= cell_end; ++cy) {
+            for (int cx{0}; cx < static_cast<int>(grid.grid_width); ++cx) {
+                const Cell& cell = grid.getCell(cx, cy);
+                if (aggregate_count > 0 && cell.getObjectCount() >= aggregate_count) {
+                    splatCell(cx, cy, grid.cell_size, ball_mass * cell.getObjectCount(), first_row, last_row);
+                    continue;
+                }
+                for (const uint32_t idx : cell.ball_indices) {
+                    const VerletBall& obj = objects[idx];
+                    // Texel centers sit at (i + 0.5) * texel_size
+                    const float fx = obj.position.x * inv_texel - 0.5f;
+                    const float fy = obj.position.y * inv_texel - 0.5f;
+                    const int x0 = static_cast<int>(std::floor(fx));
+                    const int y0 = static_cast<int>(std::floor(fy));
+                    if (y0 + 1 < first_row || y0 > last_row)
+                        continue;
+                    const float tx   = fx - x0;
+                    const float ty   = fy - y0;
+                    const float mass = PI_f * obj.radius * obj.radius / texel_area;
+                    for (int row : {y0, y0 + 1}) {
+                        if (row < first_row || row > last_row)
+                            continue;
+                        const float row_weight = mass * (row == y0 ? 1.f - ty : ty);
+                        float* line = &density[static_cast<size_t>(row) * width];
+                        if (x0 >= 0 && x0 < static_cast<int>(width))
+                            line[x0] += row_weight * (1.f - tx);
+                        if (x0 + 1 >= 0 && x0 + 1 < static_cast<int>(width))
+                            line[x0 + 1] += row_weight * tx;
+                    }
+                }
+            }
+        }
+    }
+
+    // Spread mass evenly over the texels whose centers lie in the cell (the texel holding the
+    // cell center when texels are larger than cells), clipped to the band
+    void splatCell(int cx, int cy, float cell_size, float mass, int first_row, int last_row)
+    {
+        const float inv_texel = 1.f / texel_size;
+        int x0 = static_cast<int>(std::ceil(cx * cell_size * inv_texel - 0.5f));
+        int x1 = static_cast<int>(std::ceil((cx + 1) * cell_size * inv_texel - 0.5f)) - 1;
+        int y0 = static_cast<int>(std::ceil(cy * cell_size * inv_texel - 0.5f));
+        int y1 = static_cast<int>(std::ceil((cy + 1) * cell_size * inv_texel - 0.5f)) - 1;
+        if (x1 < x0)
+            x0 = x1 = static_cast<int>((cx + 0.5f) * cell_size * inv_texel);
+        if (y1 < y0)
+            y0 = y1 = static_cast<int>((cy + 0.5f) * cell_size * inv_texel);
+        const float share = mass / static_cast<float>((x1 - x0 + 1) * (y1 - y0 + 1));
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, static_cast<int>(width) - 1);
+        for (int row{std::max(y0, first_row)}; row <= std::min(y1, last_row); ++row) {
+            float* line = &density[static_cast<size_t>(row) * width];
+            for (int x{x0}; x <= x1; ++x) {
+                line[x] += share;
+            }
+        }
+    }
+
+    // Separable Gaussian. Both passes accumulate one kernel tap at a time over a whole row,
+    // so the inner loops are plain multiply-adds over contiguous floats that the compiler
+    // vectorizes. Texels outside the field count as empty.
+    void blur()
+    {
+        const int radius = static_cast<int>(kernel.size()) - 1;
+        if (radius <= 0)
+            return;
+
+        // Horizontal: density -> scratch, through a zero padded copy of each row
+        parallelFor(height, [this, radius](size_t begin, size_t end, size_t) {
+            std::vector<float> padded(width + 2 * radius, 0.f);
+            for (size_t y{begin}; y < end; ++y) {
+                const float* in = &density[y * width];
+                float* out      = &scratch[y * width];
+                std::copy(in, in + width, padded.begin() + radius);
+                const float* center = padded.data() + radius;
+                for (uint32_t x{0}; x < width; ++x) {
+                    out[x] = kernel[0] * center[x];
+                }
+                for (int k{1}; k <= radius; ++k) {
+                    const float weight = kernel[k];
+                    const float* left  = center - k;
+                    const float* right = center + k;
+                    for (uint32_t x{0}; x < width; ++x) {
+                        out[x] += weight * (left[x] + right[x]);
+                    }
+                }
+            }
+        });
+
+        // Vertical: scratch -> density, row by row
+        parallelFor(height, [this, radius](size_t begin, size_t end, size_t) {
+            for (size_t y{begin}; y < end; ++y) {
+                float* out = &density[y * width];
+                const float* center = &scratch[y * width];
+                for (uint32_t x{0}; x < width; ++x) {
+                    out[x] = kernel[0] * center[x];
+                }
+                for (int k{1}; k <= radius; ++k) {
+                    const float weight = kernel[k];
+                    const float* above = static_cast<int>(y) - k >= 0 ? &scratch[(y - k) * width] : nullptr;
+                    const float* below = y + k < height ? &scratch[(y + k) * width] : nullptr;
+                    if (above) {
+                        for (uint32_t x{0}; x < width; ++x) {
+                            out[x] += weight * above[x];
+                        }
+                    }
+                    if (below) {
+                        for (uint32_t x{0}; x < width; ++x) {
+                            out[x] += weight * below[x];
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    void colorRows(size_t row_begin, size_t row_end)
+    {
+        const float scale = 255.f / full_density;
+        for (size_t i{row_begin * width}; i < row_end * width; ++i) {
+            const float value   = density[i];
+            const uint32_t slot = static_cast<uint32_t>(std::min(255.f, value * scale));
+            const sf::Color& color = colormap[slot];
+            uint8_t* pixel = &pixels[i * 4];
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
+            if (threshold > 0.f)
+                pixel[3] = value >= threshold ? 255 : 0;
+            else
+                pixel[3] = static_cast<uint8_t>(std::min(255u, slot * 4));  // empty space stays transparent
+        }
+    }
+};
+
+
+// Draws a DensityField as one texture, uploaded once per frame and scaled up to the world
+class DensityRenderer {
+public:
+    DensityField field;
+
+    DensityRenderer(sf::RenderTarget& render) : render(render) {}
+
+    // Rebuild the field and draw it over the whole world
+    void draw(const PhysicsSolver& solver)
+    {
+        field.build(solver);
+        const sf::Vector2u size(field.getWidth(), field.getHeight());
+        if (size != texture_size) {
+            texture.create(size.x, size.y);
+            texture.setSmooth(true);
+            sprite.setTexture(texture, true);
+            texture_size = size;
+        }
+        texture.update(field.getPixels().data());
+        sprite.setScale(field.texel_size, field.texel_size);
+        render.draw(sprite);
+    }
+
+private:
+    sf::RenderTarget& render;
+    sf::Texture texture;
+    sf::Sprite sprite;
+    sf::Vector2u texture_size = {0, 0};
+};
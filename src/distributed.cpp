@@ -0,0 +1,59 @@
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <chrono>
+#include <string>
+#define HAVE_SFML
+#include "../utils/random.h"
+#include "../headers/world.h"
+#include "../headers/distributed.h"
+
+// Headless run of the domain-decomposed solver on one machine.
+// Usage: distributed [worker processes] [ball count] [frames]
+// Checks that no ball is lost or duplicated while balls migrate between tiles.
+
+
+int main(int argc, char* argv[])
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const uint32_t tile_count = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 4;
+    const uint32_t ball_count = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 20000;
+    const uint32_t frames     = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 600;
+
+    distributed::DistributedWorld world(sf::Vector2i(windowWidth, windowHeight), tile_count);
+    utils::Random randomizer(42u);
+    for (uint32_t i = 0; i < ball_count; ++i)
+    {
+        const float x     = randomizer.generateRandomFloat(50, windowWidth - 50);
+        const float y     = randomizer.generateRandomFloat(50, windowHeight - 50);
+        const float angle = randomizer.generateRandomFloat(0, 2 * PI_f);
+        world.addObject(2.f, {x, y}, 2.f, angle, getRainbow(static_cast<float>(i)));
+    }
+
+    // The gathered solver is what a Renderer would draw
+    PhysicsSolver view(sf::Vector2i(windowWidth, windowHeight));
+    std::vector<uint32_t> tile_counts;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        world.update(deltaTime);
+        if ((frame + 1) % 100 == 0) {
+            world.gather(view, &tile_counts);
+            std::cout << "frame " << frame + 1 << ": " << view.getObjectCount() << " balls, per tile:";
+            for (const uint32_t count : tile_counts) {
+                std::cout << " " << count;
+            }
+            std::cout << "\n";
+            if (view.getObjectCount() != ball_count) {
+                std::cerr << "ball count changed from " << ball_count << "\n";
+                return 1;
+            }
+        }
+    }
+    const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << tile_count << " workers, " << elapsed / frames << " ms/frame\n";
+#else
+    std::cerr << "distributed mode needs a POSIX system\n";
+#endif
+    return 0;
+}
@@ -1,16 +1,72 @@
 #pragma once
 
-#pragma once
-
 #include <SFML/Graphics.hpp>
 #include <cmath>
 #include <vector>
 #include "../headers/verlet.h"
 
 
+// What the input layer asks the simulation to do. Events are translated into commands while
+// polling and the main loop applies them between solver updates, i.e. on a substep boundary.
+enum class CommandType : uint8_t {
+    Spawn,              // add a ball at position with speed and angle
+    TogglePause,
+    Step,               // advance one frame while paused
+    Reset,              // remove every ball and constraint
+    ToggleRenderer,     // cycle adaptive -> points -> quads -> polygons -> balls -> culled
+    ToggleHeatmap,
+    ToggleDensity,      // draw the smoothed density field instead of the balls
+    CycleColorMode,     // cycle stored -> speed -> cell -> density ball colors
+    ToggleSubSteps      // adaptive substep count <-> one substep per frame
+};
+
+struct Command {
+    CommandType type;
+    sf::Vector2f position = {0.f, 0.f};
+    float radius = 0.f;
+    float speed  = 0.f;
+    float angle  = 0.f;
+};
+
+
+// FIFO of pending commands, filled by EventHandler and drained once per frame
+class CommandQueue {
+private:
+    std::vector<Command> pending;
+    std::vector<Command> draining;
+
+public:
+    void push(const Command& command)
+    {
+        pending.push_back(command);
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return pending.empty();
+    }
+
+    // fn(command) for every queued command in arrival order; commands pushed by fn are kept
+    // for the next drain
+    template <typename F>
+    void drain(F&& fn)
+    {
+        draining.swap(pending);
+        for (const Command& command : draining) {
+            fn(command);
+        }
+        draining.clear();
+    }
+};
+
+
 class EventHandler {
 private:
     sf::RenderWindow& window;
+    bool dragging = false;
+    sf::Vector2f initial_position;
+    sf::Vector2f target_position;
     
 public:
     EventHandler(sf::RenderWindow& window) : window(window)
@@ -21,12 +77,27 @@ public:
     sf::VertexArray trajectoryLine;
     sf::ConvexShape arrowhead;
 
-    template <typename T>
-    void dragAndShoot(const sf::Event& event, PhysicsSolver& solver) {
-        static bool dragging = false;
-        static sf::Vector2f initial_position;
-        static sf::Vector2f target_position;
-        static sf::Color color = sf::Color::Red;
+    // Turn one polled event into commands. Call for every event inside the pollEvent loop.
+    void handle(const sf::Event& event, CommandQueue& commands)
+    {
+        dragAndShoot(event, commands);
+        if (event.type != sf::Event::KeyPressed)
+            return;
+        switch (event.key.code) {
+            case sf::Keyboard::P: commands.push({CommandType::TogglePause});    break;
+            case sf::Keyboard::N: commands.push({CommandType::Step});           break;
+            case sf::Keyboard::R: commands.push({CommandType::Reset});          break;
+            case sf::Keyboard::M: commands.push({CommandType::ToggleRenderer}); break;
+            case sf::Keyboard::H: commands.push({CommandType::ToggleHeatmap});  break;
+            case sf::Keyboard::D: commands.push({CommandType::ToggleDensity});  break;
+            case sf::Keyboard::C: commands.push({CommandType::CycleColorMode}); break;
+            case sf::Keyboard::S: commands.push({CommandType::ToggleSubSteps}); break;
+            default: break;
+        }
+    }
+
+    void dragAndShoot(const sf::Event& event, CommandQueue& commands) {
+        const sf::Color color = sf::Color::Red;
 
         // Start dragging when the mouse is pressed
         if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
@@ -69,9 +140,12 @@ public:
                 trajectoryLine.clear();  // Remove the line when released
                 sf::Vector2f direction = initial_position - target_position;
                 float magnitude = std::sqrt(direction.x * direction.x + direction.y * direction.y);
-                float speed = magnitude / 20.f;
-                float angle = std::atan2(direction.y, direction.x);
-                solver.addObject(4.f, target_position, speed, angle);
+                Command spawn{CommandType::Spawn};
+                spawn.position = target_position;
+                spawn.radius   = 4.f;
+                spawn.speed    = magnitude / 20.f;
+                spawn.angle    = std::atan2(direction.y, direction.x);
+                commands.push(spawn);
             }
             // Clear the arrow
             arrowhead.setPointCount(0); 
@@ -83,12 +157,4 @@ public:
             window.close();
         }
     }
-
-    bool isPaused = false;
-    void pauseAnimation() {
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::P)) {
-            isPaused = !isPaused;
-            sf::sleep(sf::seconds(20.f));
-        }
-    }
 };
\ No newline at end of file
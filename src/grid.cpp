@@ -1,60 +1,200 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <charconv>
 #define HAVE_SFML
+#define SPATIAL_COUNT_ALLOCATIONS
 #include "../utils/random.h"
 #include "../headers/world.h"
+#include "../headers/cell_tuner.h"
+#include "../headers/spawner.h"
 #include "renderer.h"
+#include "density_renderer.h"
+#include "color_attributes.h"
 #include "rainbow.h"
 #include "event.h"
 
 
+// The whole argument must be a number from 1 to 65535
+static bool parsePort(const char* text, uint16_t& port)
+{
+    const char* end = text + std::strlen(text);
+    uint32_t value  = 0;
+    const auto [last, error] = std::from_chars(text, end, value);
+    if (error != std::errc() || last != end || value == 0 || value > 65535)
+        return false;
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+
 int main(int argc, char* argv[]) 
 {
+    // Metrics export: --metrics-port <port> serves http://127.0.0.1:<port>/metrics,
+    // --metrics-file <path> rewrites a Prometheus text file every second. Parsed before the
+    // window opens, so a bad argument exits with the usage right away.
+    const char* usage = "Usage: grid [--metrics-port <1-65535>] [--metrics-file <path>]\n";
+    std::unique_ptr<utils::MetricsExporter> metrics_exporter;
+    bool metrics_requested = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg != "--metrics-port" && arg != "--metrics-file")
+            continue;
+        if (i + 1 >= argc) {
+            std::cerr << arg << ": missing value\n" << usage;
+            return 1;
+        }
+        metrics_requested = true;
+        if (arg == "--metrics-file") {
+            metrics_exporter = utils::MetricsExporter::toFile(argv[++i]);
+            continue;
+        }
+        uint16_t port;
+        if (!parsePort(argv[++i], port)) {
+            std::cerr << "--metrics-port: expected a port from 1 to 65535, got '" << argv[i] << "'\n" << usage;
+            return 1;
+        }
+        metrics_exporter = utils::MetricsExporter::serveHttp(port);
+    }
+    if (metrics_requested && !metrics_exporter)
+        std::cerr << "Metrics exporter could not be started\n";
+
     sf::ContextSettings settings;
     settings.antialiasingLevel = 1;
     sf::RenderWindow window(sf::VideoMode(windowWidth, windowHeight), "Spatial Partitioning C++", sf::Style::Default, settings);
     window.setFramerateLimit(frameRate);
     sf::Font font;
     font.loadFromFile("fonts/cmunrm.ttf");
-    utils::Random randomizer;
     Renderer renderer(window);
+    AdaptiveRenderer adaptive_renderer(renderer, 1.f / 60.f);
+    DensityRenderer density_renderer(window);
+    utils::ThreadPool render_pool;
+    density_renderer.field.setThreadPool(&render_pool);
+    ColorAttributes color_attributes;
+    color_attributes.setThreadPool(&render_pool);
     PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
     EventHandler handle_event(window);
+    CommandQueue commands;
     Information information(window, font);
+    GridStatistics grid_statistics;
+    CellSizeTuner cell_tuner;
+    bool show_heatmap = false;
+    bool show_density = false;
+    bool paused       = false;
+    int render_choice = -1;                     // -1 adaptive, 4 culled, otherwise a fixed RenderMode
+
     
     // Initialize ball settings
     const float spawn_delay           = 0.025f;
     const float initial_speed         = 5.f;              // Ball speed in m/s
     const sf::Vector2f spawn_position = {500.f, 250.f};
     const uint32_t max_balls          = 25000;
-    solver.reserve(max_balls);
+    solver.reserve(max_balls, 2.f);
+    // Fast shots get more substeps while they land, the settled pile drops back to one
+    solver.setAdaptiveSubSteps(1, 16);
 
     // Clocks
-    sf::Clock ball_clock, total_time_clock;
+    sf::Clock ball_clock, total_time_clock, frame_clock, render_clock;
 
-    /// Instant ball generation to save time
+    /// Instant ball generation to save time. Positions come from counter-based streams filled
+    /// in parallel, so the scene is the same for a given seed on any number of threads. The
+    /// spawner adds and relaxes them over the first frames within its time budget.
+    Spawner spawner;
     bool instant_generation = false;
     if(instant_generation) {
+        const utils::CounterRandom scene_random(2024);
+        std::vector<float> xs(max_balls), ys(max_balls);
+        utils::ThreadPool generation_pool;
+        generation_pool.parallelFor(0, max_balls, [&](size_t begin, size_t end, size_t) {
+            scene_random.split(0).fillUniform(xs.data() + begin, end - begin, 50.f, windowWidth - 50.f, begin);
+            scene_random.split(1).fillUniform(ys.data() + begin, end - begin, 50.f, windowHeight - 50.f, begin);
+        });
+        std::vector<SpawnRequest> scene(max_balls);
         for (uint32_t i = 0; i < max_balls; ++i) 
         {
-            const float x          = randomizer.generateRandomFloat(50, windowWidth - 50);
-            const float y          = randomizer.generateRandomFloat(50, windowHeight - 50);
-            float angle            = randomizer.generateRandomFloat(0, 2 * PI_f);
-            const float radius     = 2.f;
-            sf::Color random_color = getRainbow(static_cast<float>(i));
-            auto& obj = solver.addObject(radius, {x, y}, 0.f, 0.f);
-            obj.color = random_color;
+            const float radius = 2.f;
+            scene[i] = {radius, {xs[i], ys[i]}, 0.f, 0.f, getRainbow(static_cast<float>(i))};
+        }
+        spawner.push(solver, scene);
+    }
+
+    /// Funnel and pegboard made of static obstacles
+    bool add_obstacles = false;
+    if(add_obstacles) {
+        solver.addObstacle(Obstacle::segment({100.f, 300.f}, {540.f, 550.f}));
+        solver.addObstacle(Obstacle::segment({1100.f, 300.f}, {660.f, 550.f}));
+        for (int row = 0; row < 6; ++row) {
+            for (int col = 0; col < 20; ++col) {
+                const float x = 120.f + col * 50.f + (row % 2) * 25.f;
+                const float y = 700.f + row * 50.f;
+                solver.addObstacle(Obstacle::circle({x, y}, 6.f));
+            }
+        }
+    }
+
+    /// Cloth hanging from its top row
+    bool add_cloth = false;
+    if(add_cloth) {
+        const uint32_t cloth_width = 60, cloth_height = 30;
+        const float spacing = 8.f;
+        const uint32_t first = static_cast<uint32_t>(solver.getObjectCount());
+        for (uint32_t y = 0; y < cloth_height; ++y) {
+            for (uint32_t x = 0; x < cloth_width; ++x) {
+                auto& obj = solver.addObject(2.f, {360.f + x * spacing, 150.f + y * spacing}, 0.f, 0.f);
+                obj.color = getRainbow(static_cast<float>(x) * 0.1f);
+            }
+        }
+        auto& constraints = solver.constraints;
+        for (uint32_t y = 0; y < cloth_height; ++y) {
+            for (uint32_t x = 0; x < cloth_width; ++x) {
+                const uint32_t idx = first + y * cloth_width + x;
+                if (x + 1 < cloth_width)  constraints.addLink(solver.objects, idx, idx + 1);
+                if (y + 1 < cloth_height) constraints.addLink(solver.objects, idx, idx + cloth_width);
+            }
+        }
+        for (uint32_t x = 0; x < cloth_width; x += 6) {
+            constraints.pin(first + x, solver.objects[first + x].position);
         }
     }
 
     while (window.isOpen()) {
+        // Every polled event becomes zero or more commands; nothing touches the solver here
         sf::Event event;
         while (window.pollEvent(event)) {
             handle_event.closeWindow(event);
+            handle_event.handle(event, commands);
         }
-        handle_event.dragAndShoot<VerletBall>(event, solver);
 
-        if(!instant_generation){
+        // Apply input between solver updates. Pausing only skips the update, so rendering and
+        // event handling keep running at the frame rate.
+        bool step_once = false;
+        commands.drain([&](const Command& command) {
+            switch (command.type) {
+                case CommandType::Spawn:
+                    solver.addObject(command.radius, command.position, command.speed, command.angle);
+                    break;
+                case CommandType::TogglePause:    paused = !paused;                            break;
+                case CommandType::Step:           step_once = true;                            break;
+                case CommandType::ToggleRenderer: render_choice = render_choice < 4 ? render_choice + 1 : -1; break;
+                case CommandType::ToggleHeatmap:  show_heatmap = !show_heatmap;                break;
+                case CommandType::ToggleDensity:  show_density = !show_density;                break;
+                case CommandType::CycleColorMode: color_attributes.cycleMode();                break;
+                case CommandType::ToggleSubSteps:
+                    solver.adaptive_sub_steps = !solver.adaptive_sub_steps;
+                    if (!solver.adaptive_sub_steps)
+                        solver.setSubsSteps(1);
+                    break;
+                case CommandType::Reset:
+                    solver.clear();
+                    spawner.clear();
+                    total_time_clock.restart();
+                    break;
+            }
+        });
+        const bool run_solver = !paused || step_once;
+
+        if(!instant_generation && run_solver){
             if (solver.getObjectCount() < max_balls && ball_clock.getElapsedTime().asSeconds() >= spawn_delay)
             {
                 for (uint32_t i{5}; i > 0; i--) {
@@ -70,11 +210,40 @@ int main(int argc, char* argv[])
         }
 
         window.clear(sf::Color::Black);
-        solver.update(deltaTime);
-        renderer.renderPolygons(solver);
+        solver.setStatistics(show_heatmap ? &grid_statistics : nullptr);
+        // While the scene is prewarming only the spawner runs, the solver starts once it is
+        // relaxed. Pausing holds the spawner too.
+        const bool prewarming = !spawner.isIdle();
+        if (prewarming && run_solver)
+            spawner.step(solver);
+        if (run_solver && !prewarming) {
+            solver.update(deltaTime);
+            cell_tuner.update(solver);
+        }
+        render_clock.restart();
+        color_attributes.update(solver, deltaTime);
+        renderer.setColors(color_attributes.getColors());
+        if (show_density) {
+            density_renderer.draw(solver);
+        } else if (render_choice < 0) {
+            adaptive_renderer.setFocus(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
+            adaptive_renderer.render(solver);
+        } else if (render_choice == 4) {
+            renderer.renderCulled(solver);
+        } else {
+            renderer.renderMode(solver, static_cast<RenderMode>(render_choice));
+        }
+        renderer.renderObstacles(solver);
+        renderer.renderConstraints(solver);
+        if (show_heatmap) {
+            grid_statistics.update(solver.grid);
+            renderer.renderHeatmap(solver, grid_statistics);
+        }
         renderer.renderDragArrow(handle_event);
         information.displayInformation(total_time_clock, solver);
+        utils::Metrics::get().set(utils::Gauge::RenderSeconds, render_clock.getElapsedTime().asSeconds());
         window.display();
+        utils::Metrics::get().set(utils::Gauge::FrameSeconds, frame_clock.restart().asSeconds());
     }
 
     return 0;
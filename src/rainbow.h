@@ -1,7 +1,37 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
-static sf::Color getRainbow(float t)
+// Colors sampled from fn(t), t in [0, 1], so a colormap costs one lookup instead of its
+// sin calls or branches
+template <uint32_t Size = 256>
+struct ColorTable {
+    sf::Color colors[Size];
+
+    template <typename F>
+    explicit ColorTable(F&& fn)
+    {
+        for (uint32_t i{0}; i < Size; ++i) {
+            colors[i] = fn(static_cast<float>(i) / static_cast<float>(Size - 1));
+        }
+    }
+
+    // t is clamped to [0, 1]
+    sf::Color operator()(float t) const
+    {
+        return colors[index(t)];
+    }
+
+    // max(0, t) returns 0 for NaN
+    static uint32_t index(float t)
+    {
+        return static_cast<uint32_t>(std::min(std::max(0.f, t), 1.f) * static_cast<float>(Size - 1) + 0.5f);
+    }
+};
+
+static sf::Color computeRainbow(float t)
 {
     const float r = sin(t);
     const float g = sin(t + 0.33f * 2.0f * PI_f);
@@ -11,10 +41,36 @@ static sf::Color getRainbow(float t)
             static_cast<uint8_t>(255.0f * b * b)};
 }
 
+// computeRainbow repeats every PI (squared sines), so one period is tabulated
+static sf::Color getRainbow(float t)
+{
+    static const ColorTable<1024> table([](float u) { return computeRainbow(u * PI_f); });
+    const float period = t * (1.f / PI_f);
+    return table(period - std::floor(period));
+}
+
 static sf::Color getColorFromCell(int cell_x, int cell_y) 
 {
     uint8_t r = (cell_x * 30) % 256;
     uint8_t g = (cell_y * 30) % 256;
     uint8_t b = ((cell_x + cell_y) * 15) % 256;
     return sf::Color(r, g, b);
-}
\ No newline at end of file
+}
+
+// Black -> blue -> green -> yellow -> red for t in [0, 1]
+static sf::Color computeHeatColor(float t)
+{
+    t = std::min(std::max(t, 0.f), 1.f);
+    const float r = std::min(std::max(2.f * t - 0.5f, 0.f), 1.f);
+    const float g = std::min(std::max(t < 0.75f ? 2.f * t : 4.f * (1.f - t), 0.f), 1.f);
+    const float b = std::min(std::max(t < 0.25f ? 4.f * t : 1.f - 2.f * (t - 0.25f), 0.f), 1.f);
+    return {static_cast<uint8_t>(255.0f * r),
+            static_cast<uint8_t>(255.0f * g),
+            static_cast<uint8_t>(255.0f * b)};
+}
+
+static sf::Color getHeatColor(float t)
+{
+    static const ColorTable<256> table(computeHeatColor);
+    return table(t);
+}
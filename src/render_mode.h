@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Render paths ordered from cheapest to most detailed
+enum class RenderMode : uint8_t
+{
+    Points   = 0,
+    Quads    = 1,
+    Polygons = 2,
+    Balls    = 3
+};
+
+
+// Picks the render path from measured render times; AdaptiveRenderer feeds it one sample per
+// frame. The mode steps down as soon as the smoothed time exceeds the budget, and only steps
+// back up after the finer mode's predicted cost has stayed under the budget for hold_frames
+// frames. Costs are kept per ball and per mode. When only detailed_count balls are drawn with
+// the current mode and the rest as points (focus region), the points' share is taken out of
+// the sample before it is charged to the current mode.
+class RenderModeSelector
+{
+public:
+    static constexpr float smoothing      = 0.1f;  // EMA weight of the newest sample
+    static constexpr float upgrade_margin = 0.7f;  // finer mode must fit in 70% of the budget
+    static constexpr uint32_t hold_frames = 30;
+
+    explicit RenderModeSelector(float frame_budget = 1.f / 60.f)
+        : frame_budget(frame_budget)
+    {}
+
+    void setFrameBudget(float budget)
+    {
+        frame_budget = budget;
+    }
+
+    [[nodiscard]]
+    RenderMode getMode() const
+    {
+        return mode;
+    }
+
+    [[nodiscard]]
+    float getRenderTime() const
+    {
+        return smoothed_time;
+    }
+
+    // Seconds per ball measured for mode, 0 while unmeasured
+    [[nodiscard]]
+    float getCost(RenderMode cost_mode) const
+    {
+        return cost_per_object[static_cast<int>(cost_mode)];
+    }
+
+    // elapsed: seconds the last frame took in getMode(). detailed_count of the object_count balls
+    // get the selected mode (focus region) and the others are points; pass object_count when
+    // every ball gets it. In Points mode everything is points either way.
+    void update(float elapsed, size_t object_count, size_t detailed_count)
+    {
+        recordSample(elapsed, object_count, detailed_count);
+        selectMode(object_count, detailed_count);
+    }
+
+private:
+    float frame_budget;                      // seconds available for rendering
+    RenderMode mode         = RenderMode::Polygons;
+    float smoothed_time     = 0.f;
+    float cost_per_object[4] = {0.f, 0.f, 0.f, 0.f}; // indexed by RenderMode, 0 = not measured yet
+    uint32_t upgrade_frames = 0;
+
+    void recordSample(float elapsed, size_t object_count, size_t detailed_count)
+    {
+        smoothed_time = smoothed_time == 0.f ? elapsed : smoothed_time + smoothing * (elapsed - smoothed_time);
+        detailed_count = mode == RenderMode::Points ? object_count : std::min(detailed_count, object_count);
+        if (detailed_count == 0)
+            return;
+
+        const size_t far_count = object_count - detailed_count;
+        const float far_time   = cost_per_object[static_cast<int>(RenderMode::Points)] * static_cast<float>(far_count);
+        float& cost = cost_per_object[static_cast<int>(mode)];
+        const float sample = std::max(0.f, elapsed - far_time) / static_cast<float>(detailed_count);
+        cost = cost == 0.f ? sample : cost + smoothing * (sample - cost);
+    }
+
+    // Time of a frame drawn in with_mode, or 0 while that mode is unmeasured
+    float predict(RenderMode with_mode, size_t object_count, size_t detailed_count) const
+    {
+        const float cost = cost_per_object[static_cast<int>(with_mode)];
+        if (cost == 0.f)
+            return 0.f;
+        detailed_count = std::min(detailed_count, object_count);
+        const float far_cost = cost_per_object[static_cast<int>(RenderMode::Points)];
+        return cost * static_cast<float>(detailed_count) + far_cost * static_cast<float>(object_count - detailed_count);
+    }
+
+    // The smoothed time carries over a switch, replaced by the new mode's prediction once
+    // that mode has been measured, so a single slow frame cannot undo a switch
+    void switchTo(RenderMode new_mode, size_t object_count, size_t detailed_count)
+    {
+        mode = new_mode;
+        const float predicted = predict(mode, object_count, detailed_count);
+        if (predicted > 0.f)
+            smoothed_time = predicted;
+        upgrade_frames = 0;
+    }
+
+    void selectMode(size_t object_count, size_t detailed_count)
+    {
+        const int current = static_cast<int>(mode);
+
+        // Over budget: step down immediately and forget the upgrade streak
+        if (smoothed_time > frame_budget && mode != RenderMode::Points)
+        {
+            switchTo(static_cast<RenderMode>(current - 1), object_count, detailed_count);
+            return;
+        }
+
+        if (mode == RenderMode::Balls)
+            return;
+
+        // Unmeasured finer modes are assumed to cost what the current one does
+        const RenderMode finer = static_cast<RenderMode>(current + 1);
+        float predicted = predict(finer, object_count, detailed_count);
+        if (predicted == 0.f)
+            predicted = predict(mode, object_count, detailed_count);
+        if (predicted < frame_budget * upgrade_margin) {
+            if (++upgrade_frames >= hold_frames)
+                switchTo(finer, object_count, detailed_count);
+        } else {
+            upgrade_frames = 0;
+        }
+    }
+};
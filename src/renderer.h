@@ -2,27 +2,42 @@
 #include <SFML/Graphics.hpp>
 #include "../headers/verlet.h"
 #include "event.h"
+#include "rainbow.h"
+#include "render_mode.h"
+#include "culled_vertices.h"
 #include <charconv>
+#include <algorithm>
+
 
 class Renderer
 {
 private:
     sf::RenderTarget& render;
+    const std::vector<sf::Color>* colors = nullptr;
+    CulledVertices culled;
 public:
     Renderer(sf::RenderTarget& render) 
         : render(render)
     {}
+
+    // Per-ball colors to draw instead of VerletBall::color (borrowed, indexed like objects);
+    // nullptr draws the stored colors
+    void setColors(const std::vector<sf::Color>* ball_colors)
+    {
+        colors = ball_colors;
+    }
     
 
     void renderBalls(const PhysicsSolver& solver) const
     {
         const auto& objects = solver.objects;
         sf::CircleShape circle{1.0f};
-        for (const auto& obj : objects)
+        for (size_t idx = 0; idx < objects.size(); ++idx)
         {
+            const VerletBall& obj = objects[idx];
             circle.setRadius(obj.radius);
             circle.setOrigin(obj.radius, obj.radius);
-            circle.setFillColor(obj.color);
+            circle.setFillColor(colorOf(obj, idx));
             circle.setPosition(obj.position);
             render.draw(circle);
         }
@@ -33,8 +48,9 @@ public:
         const auto& objects = solver.objects;
         sf::VertexArray vertices(sf::Triangles);
 
-        for (const auto& obj : objects)
+        for (size_t idx = 0; idx < objects.size(); ++idx)
         {
+            const VerletBall& obj = objects[idx];
             const int triangle_count = 4; // Approximate a circle with triangles
             float angleStep = 2 * PI_f / triangle_count;
 
@@ -47,7 +63,7 @@ public:
                 sf::Vector2f point1 = center + sf::Vector2f(std::cos(angle1), std::sin(angle1)) * obj.radius;
                 sf::Vector2f point2 = center + sf::Vector2f(std::cos(angle2), std::sin(angle2)) * obj.radius;
 
-                sf::Color color = obj.color;
+                sf::Color color = colorOf(obj, idx);
 
                 // Add triangle (center, point1, point2)
                 vertices.append(sf::Vertex(center, color));
@@ -59,15 +75,28 @@ public:
         render.draw(vertices);
     }
 
+    void renderQuads(const PhysicsSolver& solver) const
+    {
+        const auto& objects = solver.objects;
+        sf::VertexArray vertices(sf::Quads);
+
+        for (size_t idx = 0; idx < objects.size(); ++idx)
+        {
+            appendQuad(vertices, objects[idx], colorOf(objects[idx], idx));
+        }
+
+        render.draw(vertices);
+    }
+
     void renderPoints(const PhysicsSolver& solver) const
     {
         const auto& objects = solver.objects;
         sf::VertexArray vertices(sf::Points);
 
-        for (const auto& obj : objects)
+        for (size_t idx = 0; idx < objects.size(); ++idx)
         {
-            sf::Vector2f center = obj.position;
-            sf::Color color = obj.color;
+            sf::Vector2f center = objects[idx].position;
+            sf::Color color = colorOf(objects[idx], idx);
             vertices.append(sf::Vertex(center, color));
         }
 
@@ -75,11 +104,262 @@ public:
     }
 
 
+    // Draw only what overlaps the current view, see CulledVertices. Returns the number of
+    // vertices emitted.
+    size_t renderCulled(const PhysicsSolver& solver)
+    {
+        const sf::View& view    = render.getView();
+        const sf::Vector2f half = view.getSize() / 2.f;
+        const float pixel_size  = view.getSize().x / static_cast<float>(render.getSize().x);
+        culled.build(solver, view.getCenter() - half, view.getCenter() + half, pixel_size, colors);
+        render.draw(culled.quads);
+        render.draw(culled.points);
+        return culled.getVertexCount();
+    }
+
+    // Draw balls within focus_radius of focus with near_mode and everything else with far_mode
+    void renderMixed(const PhysicsSolver& solver, RenderMode near_mode, RenderMode far_mode,
+                     sf::Vector2f focus, float focus_radius) const
+    {
+        const auto& objects = solver.objects;
+        const float focus_radius2 = focus_radius * focus_radius;
+        sf::VertexArray triangles(sf::Triangles);
+        sf::VertexArray quads(sf::Quads);
+        sf::VertexArray points(sf::Points);
+        sf::CircleShape circle{1.0f};
+
+        for (size_t idx = 0; idx < objects.size(); ++idx)
+        {
+            const VerletBall& obj = objects[idx];
+            const sf::Color color = colorOf(obj, idx);
+            const sf::Vector2f delta = obj.position - focus;
+            const bool is_near = delta.x * delta.x + delta.y * delta.y < focus_radius2;
+            switch (is_near ? near_mode : far_mode)
+            {
+                case RenderMode::Balls:
+                    circle.setRadius(obj.radius);
+                    circle.setOrigin(obj.radius, obj.radius);
+                    circle.setFillColor(color);
+                    circle.setPosition(obj.position);
+                    render.draw(circle);
+                    break;
+                case RenderMode::Polygons: appendPolygon(triangles, obj, color); break;
+                case RenderMode::Quads:    appendQuad(quads, obj, color);        break;
+                case RenderMode::Points:   points.append(sf::Vertex(obj.position, color)); break;
+            }
+        }
+
+        render.draw(triangles);
+        render.draw(quads);
+        render.draw(points);
+    }
+
+    void renderMode(const PhysicsSolver& solver, RenderMode mode) const
+    {
+        switch (mode)
+        {
+            case RenderMode::Balls:    renderBalls(solver);    break;
+            case RenderMode::Polygons: renderPolygons(solver); break;
+            case RenderMode::Quads:    renderQuads(solver);    break;
+            case RenderMode::Points:   renderPoints(solver);   break;
+        }
+    }
+
+    void renderObstacles(const PhysicsSolver& solver, sf::Color color = sf::Color(120, 120, 120)) const
+    {
+        const int cap_segments = 8;
+        sf::VertexArray vertices(sf::Triangles);
+
+        for (const Obstacle& obstacle : solver.obstacles.obstacles)
+        {
+            // Segments get a one pixel body so they stay visible
+            const float radius      = std::max(obstacle.radius, 1.f);
+            const sf::Vector2f axis = utils::normalize(obstacle.end - obstacle.start);
+            const sf::Vector2f side = sf::Vector2f(-axis.y, axis.x) * radius;
+            vertices.append(sf::Vertex(obstacle.start + side, color));
+            vertices.append(sf::Vertex(obstacle.end   + side, color));
+            vertices.append(sf::Vertex(obstacle.end   - side, color));
+            vertices.append(sf::Vertex(obstacle.start + side, color));
+            vertices.append(sf::Vertex(obstacle.end   - side, color));
+            vertices.append(sf::Vertex(obstacle.start - side, color));
+
+            if (obstacle.radius <= 0.f)
+                continue;
+            for (const sf::Vector2f& center : {obstacle.start, obstacle.end}) {
+                for (int i = 0; i < cap_segments; ++i) {
+                    const float angle1 = i * 2 * PI_f / cap_segments;
+                    const float angle2 = (i + 1) * 2 * PI_f / cap_segments;
+                    vertices.append(sf::Vertex(center, color));
+                    vertices.append(sf::Vertex(center + sf::Vector2f(std::cos(angle1), std::sin(angle1)) * radius, color));
+                    vertices.append(sf::Vertex(center + sf::Vector2f(std::cos(angle2), std::sin(angle2)) * radius, color));
+                }
+            }
+        }
+
+        render.draw(vertices);
+    }
+
+    void renderConstraints(const PhysicsSolver& solver, sf::Color color = sf::Color(200, 200, 200)) const
+    {
+        const auto& objects     = solver.objects;
+        const auto& constraints = solver.constraints;
+        sf::VertexArray vertices(sf::Lines, constraints.getLinkCount() * 2);
+
+        for (size_t i = 0; i < constraints.getLinkCount(); ++i)
+        {
+            vertices[2 * i]     = sf::Vertex(objects[constraints.ball_a[i]].position, color);
+            vertices[2 * i + 1] = sf::Vertex(objects[constraints.ball_b[i]].position, color);
+        }
+
+        render.draw(vertices);
+    }
+
+    // Translucent per-cell occupancy overlay, scaled to the busiest cell, with the smoothed
+    // collision time of each stripe as a bar along the right edge
+    void renderHeatmap(const PhysicsSolver& solver, const GridStatistics& stats, uint8_t alpha = 140) const
+    {
+        const Grid& grid = solver.grid;
+        if (stats.cell_occupancy.size() != grid.cells.size())
+            return;
+
+        const float max_occupancy = std::max(1.f, static_cast<float>(stats.max_occupancy));
+        const float size = grid.cell_size;
+        sf::VertexArray quads(sf::Quads);
+
+        for (uint32_t y = 0; y < grid.grid_height; ++y)
+        {
+            for (uint32_t x = 0; x < grid.grid_width; ++x)
+            {
+                const float occupancy = stats.cell_occupancy[y * grid.grid_width + x];
+                if (occupancy < 0.05f)
+                    continue;
+                sf::Color color = getHeatColor(occupancy / max_occupancy);
+                color.a = alpha;
+                quads.append(sf::Vertex({x * size,       y * size},       color));
+                quads.append(sf::Vertex({(x + 1) * size, y * size},       color));
+                quads.append(sf::Vertex({(x + 1) * size, (y + 1) * size}, color));
+                quads.append(sf::Vertex({x * size,       (y + 1) * size}, color));
+            }
+        }
+
+        float slowest = 0.f;
+        for (const float time : stats.stripe_time) {
+            slowest = std::max(slowest, time);
+        }
+        const float bar_width     = 60.f;
+        const float stripe_height = stats.stripe_rows * size;
+        const float right         = static_cast<float>(grid.window_width);
+        for (size_t stripe = 0; stripe < stats.stripe_time.size() && slowest > 0.f; ++stripe)
+        {
+            const float t = stats.stripe_time[stripe] / slowest;
+            const float top = stripe * stripe_height;
+            const sf::Color color = getHeatColor(t);
+            quads.append(sf::Vertex({right - bar_width * t, top},                        color));
+            quads.append(sf::Vertex({right,                 top},                        color));
+            quads.append(sf::Vertex({right,                 top + stripe_height - 1.f},  color));
+            quads.append(sf::Vertex({right - bar_width * t, top + stripe_height - 1.f},  color));
+        }
+
+        render.draw(quads);
+    }
+
     void renderDragArrow(const EventHandler& event) 
     {
         render.draw(event.trajectoryLine);
         render.draw(event.arrowhead);
     }
+
+private:
+    sf::Color colorOf(const VerletBall& obj, size_t idx) const
+    {
+        return colors ? (*colors)[idx] : obj.color;
+    }
+
+    static void appendPolygon(sf::VertexArray& vertices, const VerletBall& obj, sf::Color color)
+    {
+        // Same diamond as renderPolygons: 4 triangles around the center
+        const sf::Vector2f center = obj.position;
+        const sf::Vector2f corners[4] = {
+            center + sf::Vector2f( obj.radius, 0.f),
+            center + sf::Vector2f(0.f,  obj.radius),
+            center + sf::Vector2f(-obj.radius, 0.f),
+            center + sf::Vector2f(0.f, -obj.radius)
+        };
+        for (int i = 0; i < 4; ++i)
+        {
+            vertices.append(sf::Vertex(center, color));
+            vertices.append(sf::Vertex(corners[i], color));
+            vertices.append(sf::Vertex(corners[(i + 1) % 4], color));
+        }
+    }
+};
+
+
+// Draws with the mode a RenderModeSelector picks from the measured render time of each frame
+class AdaptiveRenderer
+{
+private:
+    const Renderer& renderer;
+    RenderModeSelector selector;
+
+public:
+    // Region mode: balls near the focus keep the finest affordable mode, the rest use points
+    bool use_focus_region = false;
+    sf::Vector2f focus    = {0.f, 0.f};
+    float focus_radius    = 150.f;
+
+    AdaptiveRenderer(const Renderer& renderer, float frame_budget = 1.f / 60.f)
+        : renderer(renderer)
+        , selector(frame_budget)
+    {}
+
+    void setFrameBudget(float budget)
+    {
+        selector.setFrameBudget(budget);
+    }
+
+    void setFocus(sf::Vector2f position)
+    {
+        focus = position;
+    }
+
+    [[nodiscard]]
+    RenderMode getMode() const
+    {
+        return selector.getMode();
+    }
+
+    [[nodiscard]]
+    float getRenderTime() const
+    {
+        return selector.getRenderTime();
+    }
+
+    void render(const PhysicsSolver& solver)
+    {
+        const RenderMode mode = selector.getMode();
+        sf::Clock render_clock;
+        if (use_focus_region && mode != RenderMode::Points)
+            renderer.renderMixed(solver, mode, RenderMode::Points, focus, focus_radius);
+        else
+            renderer.renderMode(solver, mode);
+        const float elapsed = render_clock.getElapsedTime().asSeconds();
+
+        const size_t object_count = solver.getObjectCount();
+        selector.update(elapsed, object_count, use_focus_region ? countNear(solver) : object_count);
+    }
+
+private:
+    size_t countNear(const PhysicsSolver& solver) const
+    {
+        const float focus_radius2 = focus_radius * focus_radius;
+        size_t count = 0;
+        for (const VerletBall& obj : solver.objects) {
+            const sf::Vector2f delta = obj.position - focus;
+            count += delta.x * delta.x + delta.y * delta.y < focus_radius2;
+        }
+        return count;
+    }
 };
 
 
@@ -0,0 +1,512 @@
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <array>
+#define HAVE_SFML
+#include "../utils/random.h"
+#include "../utils/math.h"
+#include "../utils/constants.h"
+#include "../headers/verlet.h"
+#include "../headers/world.h"
+#include "../headers/compact_world.h"
+#include "../headers/cell_tuner.h"
+#include "../src/render_mode.h"
+
+// grid_pointer.h declares its own Cell, Grid and PhysicsSolver at global scope. Its includes
+// are all pulled in above (and guarded), so wrapping it in a namespace only renames those three.
+namespace pointer_grid {
+#include "../headers/grid_pointer.h"
+}
+
+// Headless physics regression tests, one CTest case per scene.
+// Usage: regression <scene>
+//   invariants   default solver: balls inside the border, bounded overlap, energy decays
+//   determinism  same seed gives the same state; threaded Jacobi matches serial Jacobi exactly
+//   backends     Jacobi, sort and sweep, pair list, CompactWorld and grid_pointer.h against the
+//                Gauss-Seidel reference
+//   substeps     adaptive substepping: few substeps for a settled pile, more while fast balls
+//                land on it, back down once they have settled
+//   render_modes RenderModeSelector on synthetic frame times: settles on the finest mode that
+//                fits the budget and holds it, with and without a focus region
+// Tolerances are set from the current behaviour with a margin of roughly 2x (one substep is
+// soft: balls sit up to ~1 px past the border and overlap up to ~35% under a settled pile).
+// A failure means the physics changed.
+
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what, double value, double limit)
+{
+    std::cout << (condition ? "  ok    " : "  FAIL  ") << std::left << std::setw(48) << what
+              << std::fixed << std::setprecision(4) << value << " (limit " << limit << ")\n";
+    failures += !condition;
+}
+
+// The canonical scene: ball_count balls of radius 2 dropped from random positions
+struct Scene {
+    std::vector<sf::Vector2f> positions;
+
+    Scene(uint32_t ball_count, uint64_t seed, sf::Vector2f min, sf::Vector2f max)
+        : positions(ball_count)
+    {
+        const utils::CounterRandom scene_random(seed);
+        std::vector<float> xs(ball_count), ys(ball_count);
+        scene_random.split(0).fillUniform(xs, min.x, max.x);
+        scene_random.split(1).fillUniform(ys, min.y, max.y);
+        for (uint32_t i{0}; i < ball_count; ++i) {
+            positions[i] = {xs[i], ys[i]};
+        }
+    }
+};
+
+// Summary of a final state that any backend can produce
+struct Summary {
+    double mean_y       = 0.0;
+    double kinetic      = 0.0;      // mean squared move per frame
+    double max_overlap  = 0.0;      // in contact distances
+    double outside      = 0.0;      // furthest distance of a ball beyond the border
+    bool finite         = true;
+};
+
+static Summary summarize(const std::vector<sf::Vector2f>& positions, const std::vector<sf::Vector2f>& moves,
+                         float radius, sf::Vector2f top_left, sf::Vector2f bottom_right)
+{
+    Summary summary;
+    PhysicsSolver probe(sf::Vector2i(windowWidth, windowHeight));
+    for (size_t i{0}; i < positions.size(); ++i) {
+        const sf::Vector2f& p = positions[i];
+        summary.finite  = summary.finite && std::isfinite(p.x) && std::isfinite(p.y);
+        summary.mean_y += p.y;
+        summary.kinetic += moves[i].x * moves[i].x + moves[i].y * moves[i].y;
+        summary.outside  = std::max<double>(summary.outside, std::max({top_left.x + radius - p.x, p.x + radius - bottom_right.x,
+                                                                         top_left.y + radius - p.y, p.y + radius - bottom_right.y, 0.f}));
+        probe.addObject(radius, p, 0.f, 0.f);
+    }
+    summary.mean_y  /= positions.size();
+    summary.kinetic /= positions.size();
+
+    // Overlap through a grid query over the same positions
+    probe.grid.clear();
+    for (uint32_t idx{0}; idx < probe.objects.size(); ++idx) {
+        probe.grid.addBall(idx, probe.objects[idx]);
+    }
+    const Grid& grid = probe.grid;
+    for (uint32_t idx{0}; idx < probe.objects.size(); ++idx) {
+        const sf::Vector2i cell = grid.getCellCoords(positions[idx].x, positions[idx].y);
+        for (int ny = std::max(0, cell.y - 1); ny <= std::min<int>(grid.grid_height - 1, cell.y + 1); ++ny) {
+            for (int nx = std::max(0, cell.x - 1); nx <= std::min<int>(grid.grid_width - 1, cell.x + 1); ++nx) {
+                for (const uint32_t other : grid.getCell(nx, ny).ball_indices) {
+                    if (other <= idx)
+                        continue;
+                    const float dist = utils::norm2f(positions[other] - positions[idx]);
+                    summary.max_overlap = std::max<double>(summary.max_overlap, (2.f * radius - dist) / (2.f * radius));
+                }
+            }
+        }
+    }
+    return summary;
+}
+
+static Summary summarize(const std::vector<VerletBall>& objects, sf::Vector2f top_left, sf::Vector2f bottom_right)
+{
+    std::vector<sf::Vector2f> positions, moves;
+    for (const auto& obj : objects) {
+        positions.push_back(obj.position);
+        moves.push_back(obj.position - obj.previous_position);
+    }
+    return summarize(positions, moves, objects.front().radius, top_left, bottom_right);
+}
+
+static PhysicsSolver makeSolver(const Scene& scene, SolverMode mode, utils::ThreadPool* pool)
+{
+    PhysicsSolver solver(sf::Vector2i(windowWidth, windowHeight));
+    solver.setSolverMode(mode, 2);
+    solver.setThreadPool(pool);
+    solver.reserve(static_cast<int>(scene.positions.size()));
+    for (const auto& position : scene.positions) {
+        solver.addObject(2.f, position, 0.f, 0.f);
+    }
+    return solver;
+}
+
+static const uint32_t ball_count = 5000;
+static const uint32_t frames     = 600;
+
+
+static void testInvariants()
+{
+    std::cout << "invariants: " << ball_count << " balls, " << frames << " frames, Gauss-Seidel\n";
+    const Scene scene(ball_count, 1, {60.f, 60.f}, {1140.f, 600.f});
+    PhysicsSolver solver = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+    const sf::Vector2f top_left(solver.border_top_left), bottom_right(solver.border_bottom_right);
+
+    double peak_kinetic = 0.0;
+    for (uint32_t frame{0}; frame < frames; ++frame) {
+        solver.update(deltaTime);
+        if (frame % 10 == 0)
+            peak_kinetic = std::max(peak_kinetic, summarize(solver.objects, top_left, bottom_right).kinetic);
+    }
+    const Summary summary = summarize(solver.objects, top_left, bottom_right);
+
+    check(summary.finite,                          "all positions finite",                    summary.finite, 1.0);
+    check(solver.getObjectCount() == ball_count,   "ball count unchanged",                    static_cast<double>(solver.getObjectCount()), ball_count);
+    check(summary.outside < 2.0,                   "max distance outside the border (px)",    summary.outside, 2.0);
+    check(summary.max_overlap < 0.5,               "max residual overlap (contact distances)",summary.max_overlap, 0.5);
+    check(summary.kinetic < 0.25 * peak_kinetic,   "final / peak kinetic energy",             summary.kinetic / peak_kinetic, 0.25);
+    check(summary.mean_y > 1000.0,                 "pile settled at the floor (mean y)",      summary.mean_y, 1000.0);
+
+    // A resize re-bins the balls, so the grid is never read empty between updates
+    solver.setCellSize(solver.getCellSize() * 1.5f);
+    check(solver.grid.getTotalBallInGrid() == ball_count, "balls in the grid right after a resize",
+          static_cast<double>(solver.grid.getTotalBallInGrid()), ball_count);
+
+    // A steady emitter grows the count all session; the tuner searches once for the radius
+    // mix and again only after the count stops moving
+    {
+        PhysicsSolver growing(sf::Vector2i(windowWidth, windowHeight));
+        CellSizeTuner tuner;
+        uint32_t searches = 0;
+        bool was_searching = false;
+        for (uint32_t frame{0}; frame < 1200; ++frame) {
+            if (frame < 900) {
+                for (uint32_t k{0}; k < 5; ++k) {
+                    growing.addObject(2.f, {70.f, 100.f + 10.f * k}, 20.f, 0.f);
+                }
+            }
+            growing.update(deltaTime);
+            tuner.update(growing);
+            searches += tuner.isSearching() && !was_searching;
+            was_searching = tuner.isSearching();
+        }
+        check(searches <= 2, "cell size searches while the count grows, then settles", searches, 2.0);
+    }
+
+    // A ball larger than the obstacle grid's default radius rests on a segment. If the cells
+    // only listed the segment for smaller balls, it would sink in until its centre came within
+    // reach and be kicked back out, bouncing forever.
+    {
+        PhysicsSolver resting(sf::Vector2i(windowWidth, windowHeight));
+        resting.addObstacle(Obstacle::segment({300.f, 600.f}, {900.f, 600.f}));
+        resting.addObject(20.f, {600.f, 560.f}, 0.f, 0.f);
+        float drift = 0.f;
+        for (uint32_t frame{0}; frame < 300; ++frame) {
+            resting.update(deltaTime);
+            if (frame >= 120)
+                drift = std::max(drift, std::abs(resting.objects[0].position.y - 580.f));
+        }
+        check(drift < 1.f, "20 px ball resting on a segment (drift, px)", drift, 1.0);
+    }
+
+    // A ball moving 30 px in one substep jumps over a resting ball 15 px ahead. With continuous
+    // collision it stops at first contact and both balls carry on with their common velocity.
+    struct Shot {
+        float offset;       // x of the fast ball relative to the resting one
+        float fast_move;    // x moves per substep after the frame
+        float hit_move;
+    };
+    auto shoot = [](bool continuous) {
+        PhysicsSolver shot(sf::Vector2i(windowWidth, windowHeight));
+        shot.continuous_collision = continuous;
+        shot.addObject(4.f, {600.f, 600.f}, 0.f, 0.f);
+        VerletBall& fast = shot.addObject(2.f, {585.f, 600.f}, 0.f, 0.f);
+        fast.previous_position = fast.position - sf::Vector2f(30.f, 0.f);
+        shot.update(deltaTime);
+        const VerletBall& hit = shot.objects[0];
+        const VerletBall& ball = shot.objects[1];
+        return Shot{ball.position.x - hit.position.x, ball.position.x - ball.previous_position.x,
+                    hit.position.x - hit.previous_position.x};
+    };
+    const Shot tunnelled = shoot(false);
+    const Shot swept     = shoot(true);
+    check(tunnelled.offset > 0.f, "fast ball passes a ball without CCD (x offset, px)", tunnelled.offset, 0.0);
+    check(swept.offset < 0.f,     "fast ball stopped by CCD (x offset, px)",            swept.offset, 0.0);
+    // Momentum along x is kept (mass ~ radius): 2 * 30 = 2 * fast + 4 * hit
+    const float momentum = 2.f * swept.fast_move + 4.f * swept.hit_move;
+    check(swept.hit_move > 5.f,                "  hit ball pushed (px per substep)",  swept.hit_move, 5.0);
+    check(std::abs(momentum - 60.f) < 6.f,     "  momentum kept (2 * 30 px)",         momentum, 60.0);
+}
+
+static void testDeterminism()
+{
+    std::cout << "determinism: " << ball_count << " balls, " << frames / 4 << " frames\n";
+    const Scene scene(ball_count, 2, {60.f, 60.f}, {1140.f, 600.f});
+
+    PhysicsSolver first  = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+    PhysicsSolver second = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+    utils::ThreadPool pool(4);
+    PhysicsSolver serial   = makeSolver(scene, SolverMode::Jacobi, nullptr);
+    PhysicsSolver threaded = makeSolver(scene, SolverMode::Jacobi, &pool);
+    for (uint32_t frame{0}; frame < frames / 4; ++frame) {
+        first.update(deltaTime);
+        second.update(deltaTime);
+        serial.update(deltaTime);
+        threaded.update(deltaTime);
+    }
+
+    auto maxDifference = [](const PhysicsSolver& a, const PhysicsSolver& b) {
+        double difference = 0.0;
+        for (size_t i{0}; i < a.objects.size(); ++i) {
+            difference = std::max<double>(difference, utils::norm2f(a.objects[i].position - b.objects[i].position));
+        }
+        return difference;
+    };
+    const double repeat_difference = maxDifference(first, second);
+    const double thread_difference = maxDifference(serial, threaded);
+    check(repeat_difference == 0.0, "gauss-seidel run twice, max difference (px)",  repeat_difference, 0.0);
+    check(thread_difference == 0.0, "jacobi 1 vs 4 threads, max difference (px)",   thread_difference, 0.0);
+}
+
+static void testBackends()
+{
+    std::cout << "backends: " << ball_count << " balls, " << frames << " frames, compared with Gauss-Seidel\n";
+    const Scene scene(ball_count, 3, {110.f, 110.f}, {1090.f, 600.f});
+    utils::ThreadPool pool(4);
+
+    // The pile falls up to 500 px at one substep per frame, fast enough for balls to pass
+    // through each other without continuous collision (only turned off for CompactWorld)
+    auto run = [&](PhysicsSolver solver, bool continuous = true) {
+        solver.continuous_collision = continuous;
+        for (uint32_t frame{0}; frame < frames; ++frame) {
+            solver.update(deltaTime);
+        }
+        return summarize(solver.objects, sf::Vector2f(solver.border_top_left), sf::Vector2f(solver.border_bottom_right));
+    };
+
+    auto compare = [&](const std::string& name, const Summary& reference, const Summary& result,
+                       double mean_y_tolerance, double overlap_limit) {
+        std::cout << " " << name << "\n";
+        check(result.finite,                                          "  all positions finite",              result.finite, 1.0);
+        check(result.outside < 2.0,                                   "  max distance outside border (px)",  result.outside, 2.0);
+        check(result.max_overlap < overlap_limit,                     "  max residual overlap",              result.max_overlap, overlap_limit);
+        check(std::abs(result.mean_y - reference.mean_y) < mean_y_tolerance, "  mean y difference to reference (px)", std::abs(result.mean_y - reference.mean_y), mean_y_tolerance);
+    };
+
+    const Summary reference = run(makeSolver(scene, SolverMode::GaussSeidel, nullptr));
+    std::cout << " gauss-seidel reference: mean y " << reference.mean_y << ", max overlap " << reference.max_overlap << "\n";
+    compare("jacobi x2, 4 threads", reference, run(makeSolver(scene, SolverMode::Jacobi, &pool)), 5.0, 0.5);
+    {
+        PhysicsSolver sweep = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+        sweep.setBroadPhase(BroadPhase::SortAndSweep);
+        compare("sort and sweep", reference, run(std::move(sweep)), 5.0, 0.5);
+        PhysicsSolver sweep_jacobi = makeSolver(scene, SolverMode::Jacobi, &pool);
+        sweep_jacobi.setBroadPhase(BroadPhase::SortAndSweep);
+        compare("sort and sweep, jacobi x2, 4 threads", reference, run(std::move(sweep_jacobi)), 5.0, 0.5);
+    }
+    // Balls added between updates are merged into the kept order instead of rebuilding it;
+    // the pairs must match a sweep built from scratch
+    {
+        PhysicsSolver spawned(sf::Vector2i(windowWidth, windowHeight));
+        SortAndSweep incremental;
+        const auto pairsOf = [&spawned](const SortAndSweep& sweep) {
+            std::vector<std::pair<uint32_t, uint32_t>> pairs;
+            sweep.forEachPair(spawned.objects, [&pairs](uint32_t a, uint32_t b) {
+                pairs.emplace_back(std::min(a, b), std::max(a, b));
+            });
+            std::sort(pairs.begin(), pairs.end());
+            return pairs;
+        };
+        uint32_t mismatches = 0;
+        const size_t batch = scene.positions.size() / 16;
+        for (size_t start{0}; start + batch <= scene.positions.size(); start += batch) {
+            for (size_t i{start}; i < start + batch; ++i) {
+                spawned.addObject(2.f, scene.positions[i], 0.f, 0.f);
+            }
+            spawned.update(deltaTime);
+            incremental.update(spawned.objects);
+            SortAndSweep fresh;
+            fresh.update(spawned.objects);
+            mismatches += pairsOf(incremental) != pairsOf(fresh);
+        }
+        std::cout << " sort and sweep, spawned in 16 batches\n";
+        check(mismatches == 0, "  updates with pairs differing from a rebuild", mismatches, 0.0);
+    }
+    {
+        PhysicsSolver listed = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+        listed.setPairList(true);
+        compare("pair list", reference, run(std::move(listed)), 5.0, 0.5);
+        PhysicsSolver listed_jacobi = makeSolver(scene, SolverMode::Jacobi, &pool);
+        listed_jacobi.setPairList(true);
+        compare("pair list, jacobi x2, 4 threads", reference, run(std::move(listed_jacobi)), 5.0, 0.5);
+        // Cells of one contact distance leave no room for the skin: falls back to the grid path
+        PhysicsSolver listed_small = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+        listed_small.setCellSize(4.f);
+        listed_small.setPairList(true);
+        listed_small.update(deltaTime);
+        const double small_rebuilds = static_cast<double>(listed_small.getPairList().getRebuildCount());
+        compare("pair list, 4 px cells", reference, run(std::move(listed_small)), 5.0, 0.5);
+        check(small_rebuilds == 0.0, "  pair lists gathered", small_rebuilds, 0.0);
+    }
+
+    // CompactWorld has no CCD, so the reference is rerun without it. Contact order and
+    // quantization differ, which moves the pile by about 15 px.
+    {
+        const Summary no_ccd_reference = run(makeSolver(scene, SolverMode::GaussSeidel, nullptr), false);
+
+        CompactWorld world(sf::Vector2i(windowWidth, windowHeight));
+        for (const auto& position : scene.positions) {
+            world.addObject(2.f, position, 0.f, 0.f);
+        }
+        for (uint32_t frame{0}; frame < frames; ++frame) {
+            world.update(deltaTime);
+        }
+        std::vector<sf::Vector2f> positions, moves(ball_count);
+        for (uint32_t i{0}; i < ball_count; ++i) {
+            positions.push_back(world.getPosition(i));
+        }
+        compare("compact world (vs no-CCD reference)", no_ccd_reference,
+                summarize(positions, moves, 2.f, sf::Vector2f(world.border_top_left), sf::Vector2f(world.border_bottom_right)), 25.0, 0.5);
+    }
+
+    // CompactWorld palettes past their index range: extra radii and colors get the nearest entry
+    {
+        CompactWorld world(sf::Vector2i(windowWidth, windowHeight));
+        const uint32_t radius_count = static_cast<uint32_t>(CompactWorld::max_radii) + 44;
+        float radius_error = 0.f;
+        for (uint32_t i{0}; i < radius_count; ++i) {
+            const float radius = 1.f + 0.01f * static_cast<float>(i);
+            world.addObject(radius, {600.f, 600.f}, 0.f, 0.f);
+            radius_error = std::max(radius_error, std::abs(world.getRadius(i) - radius));
+        }
+        for (uint32_t i{0}; i < CompactWorld::max_colors + 100; ++i) {
+            world.addObject(2.f, {600.f, 600.f}, 0.f, 0.f, sf::Color(i & 255, (i >> 8) & 255, (i >> 16) & 255));
+        }
+        const sf::Color last = world.getColor(static_cast<uint32_t>(world.getObjectCount() - 1));
+        check(world.radius_palette.size() == CompactWorld::max_radii, "compact radius palette capped",
+              static_cast<double>(world.radius_palette.size()), CompactWorld::max_radii);
+        check(radius_error < 0.45f, "  radii quantised to the largest entry", radius_error, 0.45);
+        check(world.color_palette.size() == CompactWorld::max_colors, "compact color palette capped",
+              static_cast<double>(world.color_palette.size()), CompactWorld::max_colors);
+        // The last color is (99, 0, 1), one step from the palette entry (99, 0, 0)
+        check(last.r == 99 && last.g == 0 && last.b == 0, "  colors quantised to the nearest entry", last.b, 0.0);
+    }
+
+    // grid_pointer.h: fixed 100..1100 border with restitution on the walls, pairs resolved
+    // twice and the outer ring of cells skipped. Compared with the reference using the same
+    // border. The remaining differences leave the pile about 47 px apart.
+    {
+        PhysicsSolver bordered = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+        bordered.setBorder({100, 100}, {1100, 1100});
+        const Summary bordered_reference = run(std::move(bordered));
+
+        pointer_grid::PhysicsSolver pointer_solver(sf::Vector2i(windowWidth, windowHeight));
+        pointer_solver.objects.reserve(ball_count);     // the grid holds pointers into objects
+        for (const auto& position : scene.positions) {
+            pointer_solver.addObject(2.f, position, 0.f, 0.f);
+        }
+        for (uint32_t frame{0}; frame < frames; ++frame) {
+            pointer_solver.update(deltaTime);
+        }
+        compare("grid_pointer.h (vs 100..1100 reference)", bordered_reference,
+                summarize(pointer_solver.objects, {100.f, 100.f}, {1100.f, 1100.f}), 75.0, 0.5);
+    }
+}
+
+// Frame times from a fixed per-ball cost for each mode (seconds, indexed by RenderMode), with
+// every 37th frame 2.5x slower. Returns the number of mode switches during the last
+// measured_frames frames.
+static uint32_t driveSelector(RenderModeSelector& selector, const float (&cost)[4], size_t object_count,
+                              size_t near_count, uint32_t warmup_frames, uint32_t measured_frames)
+{
+    uint32_t switches = 0;
+    for (uint32_t frame{0}; frame < warmup_frames + measured_frames; ++frame) {
+        const RenderMode mode = selector.getMode();
+        const size_t detailed = mode == RenderMode::Points ? object_count : near_count;
+        float elapsed = cost[static_cast<int>(mode)] * static_cast<float>(detailed)
+                      + cost[static_cast<int>(RenderMode::Points)] * static_cast<float>(object_count - detailed);
+        if (frame % 37 == 0)
+            elapsed *= 2.5f;
+        selector.update(elapsed, object_count, near_count);
+        switches += frame >= warmup_frames && selector.getMode() != mode;
+    }
+    return switches;
+}
+
+static void testRenderModes()
+{
+    std::cout << "render_modes: synthetic frame times, 1/60 s budget\n";
+    const float cost[4] = {10e-9f, 40e-9f, 120e-9f, 2e-6f};    // points, quads, polygons, balls
+    const uint32_t warmup = 600, measured = 1200;
+
+    // 50k balls: polygons take 6 ms, balls 100 ms
+    RenderModeSelector whole;
+    const uint32_t whole_switches = driveSelector(whole, cost, 50000, 50000, warmup, measured);
+    check(whole.getMode() == RenderMode::Polygons, "50k balls: settles on polygons",      static_cast<double>(whole.getMode()), 2.0);
+    check(whole_switches == 0,                     "50k balls: switches after warmup",    whole_switches, 0.0);
+
+    // 200k balls: polygons take 24 ms, quads 8 ms
+    RenderModeSelector dense;
+    const uint32_t dense_switches = driveSelector(dense, cost, 200000, 200000, warmup, measured);
+    check(dense.getMode() == RenderMode::Quads,    "200k balls: steps down to quads",     static_cast<double>(dense.getMode()), 1.0);
+    check(dense_switches == 0,                     "200k balls: switches after warmup",   dense_switches, 0.0);
+
+    // Focus region: 2000 balls near the cursor as balls (4 ms), 48k far ones as points
+    RenderModeSelector region;
+    const uint32_t region_switches = driveSelector(region, cost, 50000, 2000, warmup, measured);
+    check(region.getMode() == RenderMode::Balls,   "focus region: near balls drawn as balls", static_cast<double>(region.getMode()), 3.0);
+    check(region_switches == 0,                    "focus region: switches after warmup", region_switches, 0.0);
+    // The slow frames keep the smoothed cost up to ~15% high
+    const double cost_error = std::abs(region.getCost(RenderMode::Balls) / cost[3] - 1.f);
+    check(cost_error < 0.25,                       "focus region: balls cost per ball error", cost_error, 0.25);
+}
+
+
+static void testAdaptiveSubSteps()
+{
+    const uint32_t pile_count = 1000;
+    std::cout << "substeps: " << pile_count << " ball pile, 1 to 16 substeps, 20 balls shot into it at frame 400\n";
+    const Scene scene(pile_count, 4, {60.f, 1000.f}, {1140.f, 1140.f});
+    PhysicsSolver solver = makeSolver(scene, SolverMode::GaussSeidel, nullptr);
+    solver.setAdaptiveSubSteps(1, 16);
+
+    // Mean substeps over the 100 frames before the shot and 500 to 600 frames after it
+    double settled = 0.0, recovered = 0.0;
+    uint32_t peak  = 0;
+    for (uint32_t frame{0}; frame < 1000; ++frame) {
+        if (frame == 400) {
+            for (uint32_t k{0}; k < 20; ++k) {
+                VerletBall& ball = solver.addObject(2.f, {100.f + 50.f * k, 300.f}, 0.f, 0.f);
+                ball.previous_position = ball.position - sf::Vector2f(0.f, 20.f);   // 20 px per substep down
+            }
+        }
+        solver.update(deltaTime);
+        const uint32_t steps = solver.getSubSteps();
+        if (frame >= 300 && frame < 400)
+            settled += steps / 100.0;
+        else if (frame >= 400 && frame < 430)
+            peak = std::max(peak, steps);
+        else if (frame >= 900)
+            recovered += steps / 100.0;
+    }
+
+    check(settled <= 2.0,         "settled pile, mean substeps",              settled, 2.0);
+    check(peak >= 8,              "most substeps while the shot lands",       peak, 8.0);
+    check(recovered <= 2.0,       "mean substeps once the shot has settled",  recovered, 2.0);
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string scene = argc > 1 ? argv[1] : "invariants";
+
+    if (scene == "invariants") {
+        testInvariants();
+    } else if (scene == "determinism") {
+        testDeterminism();
+    } else if (scene == "backends") {
+        testBackends();
+    } else if (scene == "substeps") {
+        testAdaptiveSubSteps();
+    } else if (scene == "render_modes") {
+        testRenderModes();
+    } else {
+        std::cerr << "unknown scene: " << scene << "\n";
+        return 1;
+    }
+    std::cout << (failures ? "FAILED" : "passed") << "\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+namespace utils{
+
+// Monotonic counters, summed over threads in a snapshot
+enum class Counter : uint32_t {
+    SubSteps,
+    SubStepNanoseconds,
+    PairTests,
+    GridRebuilds,
+    GridRebuildNanoseconds,
+    Count
+};
+
+// Last written value wins
+enum class Gauge : uint32_t {
+    ActiveBalls,
+    SubStepsPerFrame,
+    RenderSeconds,
+    FrameSeconds,
+    Count
+};
+
+// Lock-free metrics registry. Each thread gets its own cache-line aligned slot on first use
+// and is the only writer of it, so an increment is a relaxed load + store with no atomic
+// read-modify-write and no sharing. Readers (the exporter) sum the slots with relaxed loads.
+// Slots are never freed, so a snapshot stays valid after a thread exits.
+class Metrics {
+private:
+    static constexpr size_t counter_count = static_cast<size_t>(Counter::Count);
+    static constexpr size_t gauge_count   = static_cast<size_t>(Gauge::Count);
+
+    struct alignas(64) Slot {
+        std::array<std::atomic<uint64_t>, counter_count> values{};
+    };
+
+    mutable std::mutex slots_mutex;               // only taken on thread registration and snapshots
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::array<std::atomic<double>, gauge_count> gauges{};
+    std::atomic<uint64_t> allocations{0};
+
+    Slot& localSlot()
+    {
+        thread_local Slot* slot = registerSlot();
+        return *slot;
+    }
+
+    Slot* registerSlot()
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        slots.push_back(std::make_unique<Slot>());
+        return slots.back().get();
+    }
+
+public:
+    struct Snapshot {
+        std::array<uint64_t, counter_count> counters{};
+        std::array<double, gauge_count> gauges{};
+        uint64_t allocations = 0;
+    };
+
+    static Metrics& get()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    void add(Counter counter, uint64_t value = 1)
+    {
+        auto& cell = localSlot().values[static_cast<size_t>(counter)];
+        cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void set(Gauge gauge, double value)
+    {
+        gauges[static_cast<size_t>(gauge)].store(value, std::memory_order_relaxed);
+    }
+
+    // Called from the global allocator hook, which must not allocate itself
+    void countAllocation()
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    Snapshot snapshot() const
+    {
+        Snapshot result;
+        {
+            std::lock_guard<std::mutex> lock(slots_mutex);
+            for (const auto& slot : slots) {
+                for (size_t i{0}; i < counter_count; ++i) {
+                    result.counters[i] += slot->values[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        for (size_t i{0}; i < gauge_count; ++i) {
+            result.gauges[i] = gauges[i].load(std::memory_order_relaxed);
+        }
+        result.allocations = allocations.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    // Prometheus text exposition format
+    [[nodiscard]]
+    std::string toPrometheus() const
+    {
+        const Snapshot snap = snapshot();
+        std::ostringstream out;
+        out.precision(12);
+        auto counter = [&](const char* name, const char* help, double value) {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n" << name << " " << value << "\n";
+        };
+        auto gauge = [&](const char* name, const char* help, double value) {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " gauge\n" << name << " " << value << "\n";
+        };
+        auto c = [&snap](Counter id) { return static_cast<double>(snap.counters[static_cast<size_t>(id)]); };
+        auto g = [&snap](Gauge id)   { return snap.gauges[static_cast<size_t>(id)]; };
+
+        counter("spatial_substeps_total",                   "Solver substeps run",                    c(Counter::SubSteps));
+        counter("spatial_substep_seconds_total",            "Time spent in solver substeps",          c(Counter::SubStepNanoseconds) * 1e-9);
+        counter("spatial_pair_tests_total",                 "Narrow phase ball pair tests",           c(Counter::PairTests));
+        counter("spatial_grid_rebuilds_total",              "Grid rebuilds",                          c(Counter::GridRebuilds));
+        counter("spatial_grid_rebuild_seconds_total",       "Time spent rebuilding the grid",         c(Counter::GridRebuildNanoseconds) * 1e-9);
+        counter("spatial_allocations_total",                "Heap allocations (0 unless counted)",    static_cast<double>(snap.allocations));
+        gauge("spatial_active_balls",                       "Balls in the solver",                    g(Gauge::ActiveBalls));
+        gauge("spatial_substeps_per_frame",                 "Substeps in the last frame",             g(Gauge::SubStepsPerFrame));
+        gauge("spatial_render_seconds",                     "Render time of the last frame",          g(Gauge::RenderSeconds));
+        gauge("spatial_frame_seconds",                      "Wall time of the last frame",            g(Gauge::FrameSeconds));
+        return out.str();
+    }
+};
+
+
+// Background exporter. In file mode the snapshot is written every interval to a temporary
+// file and renamed over the target, so readers never see a partial file. In HTTP mode a
+// localhost socket answers every request with a fresh snapshot. Either way the simulation
+// thread is never touched: the exporter only reads the registry.
+class MetricsExporter {
+private:
+    std::thread worker;
+    std::atomic<bool> running{true};
+
+    void fileLoop(std::string path, std::chrono::milliseconds interval)
+    {
+        const std::string temp_path = path + ".tmp";
+        while (running.load()) {
+            {
+                std::ofstream out(temp_path, std::ios::trunc);
+                out << Metrics::get().toPrometheus();
+            }
+            std::rename(temp_path.c_str(), path.c_str());
+            sleepFor(interval);
+        }
+    }
+
+    void sleepFor(std::chrono::milliseconds interval)
+    {
+        const auto until = std::chrono::steady_clock::now() + interval;
+        while (running.load() && std::chrono::steady_clock::now() < until) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    void httpLoop(int server_fd)
+    {
+        pollfd pfd{server_fd, POLLIN, 0};
+        while (running.load()) {
+            if (poll(&pfd, 1, 200) <= 0)
+                continue;
+            const int client = accept(server_fd, nullptr, nullptr);
+            if (client < 0)
+                continue;
+
+            // The request itself is irrelevant, every path returns the metrics
+            char request[1024];
+            pollfd cfd{client, POLLIN, 0};
+            if (poll(&cfd, 1, 200) > 0)
+                (void)!::read(client, request, sizeof(request));
+
+            const std::string body = Metrics::get().toPrometheus();
+            const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                                       + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            (void)!::write(client, response.data(), response.size());
+            ::close(client);
+        }
+        ::close(server_fd);
+    }
+#endif
+
+    MetricsExporter() = default;
+
+public:
+    ~MetricsExporter()
+    {
+        running.store(false);
+        if (worker.joinable())
+            worker.join();
+    }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    static std::unique_ptr<MetricsExporter> toFile(const std::string& path, std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+    {
+        std::unique_ptr<MetricsExporter> exporter(new MetricsExporter());
+        MetricsExporter* self = exporter.get();
+        exporter->worker = std::thread([self, path, interval] { self->fileLoop(path, interval); });
+        return exporter;
+    }
+
+    // Listens on 127.0.0.1:port; returns nullptr if the port cannot be bound
+    static std::unique_ptr<MetricsExporter> serveHttp(uint16_t port)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (server_fd < 0)
+            return nullptr;
+        const int reuse = 1;
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_port        = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server_fd, 8) != 0) {
+            ::close(server_fd);
+            return nullptr;
+        }
+        std::unique_ptr<MetricsExporter> exporter(new MetricsExporter());
+        MetricsExporter* self = exporter.get();
+        exporter->worker = std::thread([self, server_fd] { self->httpLoop(server_fd); });
+        return exporter;
+#else
+        (void)port;
+        return nullptr;
+#endif
+    }
+};
+
+}
+
+
+// Define SPATIAL_COUNT_ALLOCATIONS in exactly one translation unit before including this
+// header to count every global operator new in spatial_allocations_total. Every replaceable
+// form (array, nothrow, aligned) is defined here, so each new meets the matching delete.
+#ifdef SPATIAL_COUNT_ALLOCATIONS
+namespace utils::allocation_hook {
+
+inline void* allocate(std::size_t size) noexcept
+{
+    utils::Metrics::get().countAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+// Over-allocate and keep the malloc pointer just below the aligned block
+inline void* allocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+    const std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    void* base = allocate(size + align + sizeof(void*));
+    if (!base)
+        return nullptr;
+    const std::uintptr_t start   = reinterpret_cast<std::uintptr_t>(base) + sizeof(void*);
+    const std::uintptr_t aligned = (start + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1);
+    reinterpret_cast<void**>(aligned)[-1] = base;
+    return reinterpret_cast<void*>(aligned);
+}
+
+inline void freeAligned(void* ptr) noexcept
+{
+    if (ptr)
+        std::free(static_cast<void**>(ptr)[-1]);
+}
+
+inline void* allocateOrThrow(std::size_t size)
+{
+    if (void* ptr = allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+inline void* allocateAlignedOrThrow(std::size_t size, std::align_val_t alignment)
+{
+    if (void* ptr = allocateAligned(size, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+}
+
+void* operator new(std::size_t size)   { return utils::allocation_hook::allocateOrThrow(size); }
+void* operator new[](std::size_t size) { return utils::allocation_hook::allocateOrThrow(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return utils::allocation_hook::allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return utils::allocation_hook::allocate(size); }
+
+void operator delete(void* ptr) noexcept                                { std::free(ptr); }
+void operator delete[](void* ptr) noexcept                              { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept                   { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept                 { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept         { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept       { std::free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)   { return utils::allocation_hook::allocateAlignedOrThrow(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return utils::allocation_hook::allocateAlignedOrThrow(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept   { return utils::allocation_hook::allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return utils::allocation_hook::allocateAligned(size, alignment); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept                          { utils::allocation_hook::freeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept                        { utils::allocation_hook::freeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept             { utils::allocation_hook::freeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept           { utils::allocation_hook::freeAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept   { utils::allocation_hook::freeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { utils::allocation_hook::freeAligned(ptr); }
+#endif
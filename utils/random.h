@@ -9,6 +9,9 @@
 #include <ctime>
 #include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
 
 
 // automatically defined by the compiler when compile code on a Windows platform.
@@ -279,6 +282,152 @@ VkClearColorValue toVkClearColorValue(const ColorRGBA& color) {
 };
 
 
+/*
+    ------------------------------------------------------------------------------------------
+
+    Counter-based generator (Philox4x32-10, Salmon et al. 2011). The n-th number of a stream is
+    a pure function of (seed, stream, n): there is no hidden state to share, so any thread can
+    produce any slice of a sequence and the result does not depend on how work was split.
+    Use one stream per purpose (x, y, angle, ...) and fill slices in parallel with the
+    `first` argument of fillUniform. Output is identical on every platform for a given seed.
+
+    ------------------------------------------------------------------------------------------
+ */
+class CounterRandom {
+private:
+    uint64_t seed;
+    uint32_t stream;
+    uint64_t position = 0;
+
+    static void mulHiLo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+    {
+        const uint64_t product = static_cast<uint64_t>(a) * b;
+        hi = static_cast<uint32_t>(product >> 32);
+        lo = static_cast<uint32_t>(product);
+    }
+
+    // Four 32-bit outputs for block number `block`
+    void generateBlock(uint64_t block, uint32_t out[4]) const
+    {
+        uint32_t c0 = static_cast<uint32_t>(block);
+        uint32_t c1 = static_cast<uint32_t>(block >> 32);
+        uint32_t c2 = stream;
+        uint32_t c3 = 0;
+        uint32_t k0 = static_cast<uint32_t>(seed);
+        uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round{0}; round < 10; ++round) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulHiLo(0xD2511F53u, c0, hi0, lo0);
+            mulHiLo(0xCD9E8D57u, c2, hi1, lo1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    // 24 high bits -> [0, 1)
+    static float toUnitFloat(uint32_t value)
+    {
+        return static_cast<float>(value >> 8) * (1.f / 16777216.f);
+    }
+
+public:
+    explicit CounterRandom(uint64_t seed, uint32_t stream = 0)
+        : seed(seed)
+        , stream(stream)
+    {}
+
+    // Independent sequence with the same seed
+    [[nodiscard]]
+    CounterRandom split(uint32_t stream_id) const
+    {
+        return CounterRandom(seed, stream_id);
+    }
+
+    // n-th 32-bit number of this stream
+    [[nodiscard]]
+    uint32_t at(uint64_t index) const
+    {
+        uint32_t block[4];
+        generateBlock(index >> 2, block);
+        return block[index & 3];
+    }
+
+    void seek(uint64_t index)
+    {
+        position = index;
+    }
+
+    uint32_t nextUInt()
+    {
+        return at(position++);
+    }
+
+    float nextFloat(float min = 0.0f, float max = 1.0f)
+    {
+        return min + (max - min) * toUnitFloat(nextUInt());
+    }
+
+    // out[i] = number first + i mapped to [min, max). The main loop runs lanes blocks side by
+    // side in structure-of-arrays form so the rounds vectorise; nothing is allocated. Slices
+    // may be filled by different threads in any order.
+    void fillUniform(float* out, size_t count, float min, float max, uint64_t first = 0) const
+    {
+        constexpr size_t lanes = 8;
+        const float scale = (max - min) * (1.f / 16777216.f);
+        size_t i = 0;
+        // Leading values up to a block boundary
+        while (i < count && ((first + i) & 3) != 0) {
+            out[i] = min + scale * static_cast<float>(at(first + i) >> 8);
+            ++i;
+        }
+        for (; count - i >= 4 * lanes; i += 4 * lanes) {
+            const uint64_t block = (first + i) >> 2;
+            uint32_t c0[lanes], c1[lanes], c2[lanes], c3[lanes];
+            for (size_t lane{0}; lane < lanes; ++lane) {
+                c0[lane] = static_cast<uint32_t>(block + lane);
+                c1[lane] = static_cast<uint32_t>((block + lane) >> 32);
+                c2[lane] = stream;
+                c3[lane] = 0;
+            }
+            uint32_t k0 = static_cast<uint32_t>(seed);
+            uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+            for (int round{0}; round < 10; ++round) {
+                for (size_t lane{0}; lane < lanes; ++lane) {
+                    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0[lane];
+                    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2[lane];
+                    c0[lane] = static_cast<uint32_t>(p1 >> 32) ^ c1[lane] ^ k0;
+                    c1[lane] = static_cast<uint32_t>(p1);
+                    c2[lane] = static_cast<uint32_t>(p0 >> 32) ^ c3[lane] ^ k1;
+                    c3[lane] = static_cast<uint32_t>(p0);
+                }
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            for (size_t lane{0}; lane < lanes; ++lane) {
+                float* dst = out + i + 4 * lane;
+                dst[0] = min + scale * static_cast<float>(c0[lane] >> 8);
+                dst[1] = min + scale * static_cast<float>(c1[lane] >> 8);
+                dst[2] = min + scale * static_cast<float>(c2[lane] >> 8);
+                dst[3] = min + scale * static_cast<float>(c3[lane] >> 8);
+            }
+        }
+        for (; i < count; ++i) {
+            out[i] = min + scale * static_cast<float>(at(first + i) >> 8);
+        }
+    }
+
+    void fillUniform(std::vector<float>& out, float min, float max, uint64_t first = 0) const
+    {
+        fillUniform(out.data(), out.size(), min, max, first);
+    }
+};
+
+
 // Initialize the sequential seed
 std::atomic<unsigned int> utils::Random::sequentialSeed(0);
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <algorithm>
+#include <cstdint>
+
+namespace utils{
+
+// Fixed-size fork/join pool. parallelFor splits a range into one chunk per worker and blocks
+// until every chunk is done, so callers can treat it like a plain loop.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable task_available;
+    std::condition_variable tasks_done;
+    size_t pending = 0;
+    bool stopping  = false;
+
+    void workerLoop()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                task_available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                if (--pending == 0)
+                    tasks_done.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency())
+    {
+        thread_count = std::max<size_t>(1, thread_count);
+        workers.reserve(thread_count);
+        for (size_t i{0}; i < thread_count; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        task_available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    [[nodiscard]]
+    size_t getThreadCount() const
+    {
+        return workers.size();
+    }
+
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.push(std::move(task));
+            ++pending;
+        }
+        task_available.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        tasks_done.wait(lock, [this] { return pending == 0; });
+    }
+
+    // fn(start, end, chunk) is called once per chunk, chunk < getThreadCount()
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, F&& fn)
+    {
+        if (end <= begin)
+            return;
+        const size_t count       = end - begin;
+        const size_t chunk_count = std::min(count, workers.size());
+        const size_t chunk_size  = (count + chunk_count - 1) / chunk_count;
+        for (size_t chunk{0}; chunk < chunk_count; ++chunk) {
+            const size_t start = begin + chunk * chunk_size;
+            const size_t stop  = std::min(end, start + chunk_size);
+            if (start >= stop)
+                break;
+            enqueue([&fn, start, stop, chunk] { fn(start, stop, chunk); });
+        }
+        wait();
+    }
+};
+
+}